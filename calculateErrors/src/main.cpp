@@ -1,11 +1,13 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <mutex>
 #include <options.h>
 #include <h5pp/h5pp.h>
 #include <fmt/core.h>
 #include "matplot/matplot.h"
 #include "matrixConversion.h"
+#include "SegmentReader.h"
 #include "ErrorMeasures.h"
 
 using namespace std;
@@ -34,11 +36,15 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Residuals of the following segments are read in background while the current segment
+    // is being processed.
+    SegmentReader reader(residualsFile, "residuals", segmentsNumber,
+                         ops.getInt("prefetchDepth", 2));
+
     for (int segmentID=0; segmentID < segmentsNumber; segmentID++){
         // read residuals
-        Eigen::MatrixXf residuals;
-        residualsFile.readDataset(residuals,
-                                  fmt::format("segments/{}/residuals", segmentID) );        
+        RowMajorMatrixXf residuals;
+        reader.read(segmentID, residuals);
         int T = residuals.rows();
 
         // calculate error measures
@@ -52,6 +58,8 @@ int main(int argc, char* argv[])
         }
 
         // output measures
+        // The reader may be accessing HDF5 in background.
+        lock_guard<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
         errorMeasuresFile.writeDataset(means,
                                    fmt::format("segments/{}/means",  segmentID) );
         errorMeasuresFile.writeDataset(pnrs,
@@ -60,5 +68,8 @@ int main(int argc, char* argv[])
                                    fmt::format("segments/{}/errors", segmentID) );
     }
 
+    reader.printStatistics();
+
+    lock_guard<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
     errorMeasuresFile.writeDataset(segmentsNumber, "/segmentsNumber");
 }
@@ -0,0 +1,115 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <options.h>
+#include <nanotimer.h>
+#include <h5pp/h5pp.h>
+#include <fmt/core.h>
+#include "SegmentReader.h"
+
+using namespace std;
+using namespace options;
+using namespace h5pp;
+
+// Converts a file of the per-segment layout to the flat layout (see SegmentReader.h). All
+// segments are appended to one chunked matrix "/{datasetName}", and the offsets of the
+// segments are written to "/segmentOffsets". Scalars describing the segments are copied.
+int main(int argc, char* argv[])
+{
+    OptionsInstance instance(argc, argv);
+    options::Options& ops = OptionsInstance::get();
+
+    string datasetName = ops.getString("datasetName");
+    if (datasetName.empty()){
+        datasetName = "features";
+    }
+    const hsize_t chunkRows = ops.getInt("chunkRows", 1024);
+
+    File inputFile ( ops.getString("inputFeature"),   FilePermission::READONLY);
+    File outputFile( ops.getString("outputFeature"),  FilePermission::REPLACE);
+    cout << "convert to flat layout: \n"
+         << "  input   : " << ops.getString("inputFeature") << "\n"
+         << "  output  : " << ops.getString("outputFeature") << "\n"
+         << "  dataset : " << datasetName << "\n";
+
+    int segmentsNumber;
+    inputFile.readDataset(segmentsNumber, "/segmentsNumber");
+    outputFile.writeDataset(segmentsNumber, "/segmentsNumber");
+    if ( inputFile.linkExists("/framesPerSegment") ){
+        int framesPerSegment;
+        inputFile.readDataset(framesPerSegment, "/framesPerSegment");
+        outputFile.writeDataset(framesPerSegment, "/framesPerSegment");
+    }
+
+    nanotimer timer;
+    timer.start();
+
+    SegmentReader reader(inputFile, datasetName, segmentsNumber,
+                         ops.getInt("prefetchDepth", 2));
+    h5pp::hid::h5f file = outputFile.openFileHandle();
+    hid_t dataset = -1;
+    vector<long> segmentOffsets(1, 0);
+    for (int segmentID=0; segmentID < segmentsNumber; segmentID++){
+        RowMajorMatrixXf matrix;
+        reader.read(segmentID, matrix);
+        const hsize_t cols = matrix.cols();
+
+        // The reader may be accessing HDF5 in background.
+        lock_guard<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
+
+        // create the matrix, whose number of rows is extended when appending segments.
+        if (dataset < 0){
+            hsize_t dims[2]    = { 0, cols };
+            hsize_t maxDims[2] = { H5S_UNLIMITED, cols };
+            hsize_t chunk[2]   = { chunkRows, cols };
+            hid_t space = H5Screate_simple(2, dims, maxDims);
+            hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+            H5Pset_chunk(properties, 2, chunk);
+            dataset = H5Dcreate2(file, ("/" + datasetName).c_str(), H5T_NATIVE_FLOAT, space,
+                                 H5P_DEFAULT, properties, H5P_DEFAULT);
+            H5Pclose(properties);
+            H5Sclose(space);
+            if (dataset < 0){
+                cout << "failed to create /" << datasetName << "\n";
+                exit(-1);
+            }
+        }
+
+        // append the segment.
+        hsize_t startRow   = segmentOffsets.back();
+        hsize_t newDims[2] = { startRow + matrix.rows(), cols };
+        if ( H5Dset_extent(dataset, newDims) < 0 ){
+            cout << "failed to extend /" << datasetName << " for segment " << segmentID << "\n";
+            exit(-1);
+        }
+        hid_t fileSpace = H5Dget_space(dataset);
+        hsize_t offset[2] = { startRow, 0 };
+        hsize_t count[2]  = { hsize_t(matrix.rows()), cols };
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        hid_t memorySpace = H5Screate_simple(2, count, nullptr);
+        if ( H5Dwrite(dataset, H5T_NATIVE_FLOAT, memorySpace, fileSpace,
+                      H5P_DEFAULT, matrix.data()) < 0 ){
+            cout << "failed to write segment " << segmentID << "\n";
+            exit(-1);
+        }
+        H5Sclose(memorySpace);
+        H5Sclose(fileSpace);
+
+        segmentOffsets.push_back( newDims[0] );
+
+        // report progress.
+        if ( (segmentID+1) % 1000 == 0 ){
+            cout << "converted " << segmentID + 1 << " of " << segmentsNumber << " segments\n";
+        }
+    }
+
+    lock_guard<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
+    if (dataset >= 0){
+        H5Dclose(dataset);
+    }
+    outputFile.writeDataset(segmentOffsets, "/segmentOffsets");
+
+    cout << "converted " << segmentsNumber << " segments (" << segmentOffsets.back()
+         << " rows), spent " << timer.get_elapsed_ms() << " ms\n";
+}
@@ -4,6 +4,10 @@
 
 using std::vector;
 
+// A matrix with row-major storage, so that each row is contiguous in memory. This is also
+// the layout of a matrix in a HDF5 file.
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXf;
+
 // STL containers to Eigen matrixes/vectors.
 void vecVecToMatrix(const vector<vector<float> >& vecVec,  Eigen::MatrixXf& matrix);
 
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "cluster/Dataset.h"
+
+// A dataset whose points are memory-mapped from a binary cache file, so that points are
+// served directly from the mapping, without decoding or copying.
+//
+// The cache file consists of a header padded to a page, followed by all points as rows of
+// floats. The header records the sizes and modification times of the source files, e.g. of
+// all files of a list; if any source file has changed, or the cache does not exist, the
+// cache is (re)written from the source dataset. Cursors share the mapping.
+class MappedDataset: public Dataset{
+public:
+    MappedDataset(const std::string& cacheFilename,
+                  const std::vector<std::string>& sourceFilenames, Dataset& source);
+
+    PointView point(PointIndex pointIndex) override;
+    BlockView getBlock(PointIndex startX, PointIndex endX) override;
+    std::unique_ptr<Dataset> createCursor() override;
+
+private:
+    struct Header{
+        char     magic[8];
+        uint32_t version;
+        uint32_t headerBytes;  // offset of the points in the file.
+        int64_t  rows;
+        int64_t  cols;
+        int64_t  sourceSize;              // total size of the source files.
+        int64_t  sourceModificationTime;  // the latest modification time of them.
+        uint64_t sourceHash;  // hash of the names, sizes and modification times of them.
+    };
+
+    // Fill a header describing the source, except for cols, which is left 0, as it can
+    // only be known by reading a point of the source.
+    Header makeHeader(const std::vector<std::string>& sourceFilenames, Dataset& source);
+    // Whether the cache file exists and matches the header, except for cols. If so, cols
+    // of the header is set to that of the cache.
+    bool isValid(const std::string& cacheFilename, Header& expected);
+    void write(const std::string& cacheFilename, const Header& header, Dataset& source);
+    void map(const std::string& cacheFilename);
+
+private:
+    int vectorDimension;
+
+    // unmapped when the dataset and all its cursors are destroyed.
+    std::shared_ptr<const void> mapping;
+    const float* points;  // the first point, in the mapping.
+};
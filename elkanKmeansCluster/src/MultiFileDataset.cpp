@@ -0,0 +1,206 @@
+#include <limits>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+#include <options.h>
+#include <nanotimer.h>
+#include "MultiFileDataset.h"
+
+using namespace std;
+
+MultiFileDataset::MultiFileDataset(const vector<string>& filenames, int maxOpenFiles_):
+    maxOpenFiles(std::max(1, maxOpenFiles_)), fileOpenings(0), cachedSegment(-1)
+{
+    nanotimer timer;
+    timer.start();
+
+    // read the shapes of the files. Files are closed right after, they are opened again
+    // when their points are accessed.
+    shared_ptr< vector<FileInfo> > scannedFiles = make_shared< vector<FileInfo> >();
+    vector<int> segmentsNumbers;
+    PointIndex framesNumber = 0;
+    long allSegmentsNumber  = 0;
+    for (const string& filename: filenames){
+        int segmentsNumber, framesPerSegment;
+        {
+            lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+            h5pp::File h5File(filename, h5pp::FilePermission::READONLY);
+            h5File.readDataset(segmentsNumber,   "/segmentsNumber");
+            h5File.readDataset(framesPerSegment, "/framesPerSegment");
+        }
+        // Blocks are segments, and a block length is shared by all points of a dataset.
+        if ( !scannedFiles->empty() &&
+             framesPerSegment != scannedFiles->front().framesPerSegment ){
+            const FileInfo& first = scannedFiles->front();
+            throw runtime_error(filename + " has " + to_string(framesPerSegment) +
+                                " frames per segment, but " + first.filename + " has " +
+                                to_string(first.framesPerSegment));
+        }
+
+        scannedFiles->push_back( FileInfo{filename, framesNumber, framesPerSegment,
+                                          segmentsNumber, int(allSegmentsNumber)} );
+        segmentsNumbers.push_back(segmentsNumber);
+        framesNumber      += PointIndex(segmentsNumber) * framesPerSegment;
+        allSegmentsNumber += segmentsNumber;
+    }
+    assert( !filenames.empty() );
+    assert( allSegmentsNumber < numeric_limits<int>::max() );
+
+    options::Options& ops = options::OptionsInstance::get();
+    if (ops.presents("ratioOfDatabaseToUse") ){
+        framesNumber *= ops.getDouble("ratioOfDatabaseToUse", 0.0);
+    }
+
+    // Only segments containing the used frames are read.
+    for (size_t i=0; i<scannedFiles->size(); i++){
+        FileInfo& info = (*scannedFiles)[i];
+        PointIndex usedFrames = std::max(PointIndex(0), framesNumber - info.startX);
+        PointIndex usedSegments = (usedFrames + info.framesPerSegment - 1) / info.framesPerSegment;
+        info.usedSegmentsNumber = std::min(usedSegments, PointIndex(segmentsNumbers[i]));
+    }
+
+    files = scannedFiles;
+    setSize(framesNumber);
+
+    long cacheBudget = ops.getInt("segmentCacheMB", 256) * 1024L * 1024L;
+    cache = make_shared<SegmentCache>(cacheBudget);
+
+    cout << "scanned " << files->size() << " feature files, " << framesNumber
+         << " frames in total, spent " << timer.get_elapsed_ms() << " ms\n";
+}
+
+MultiFileDataset::MultiFileDataset(shared_ptr<const vector<FileInfo> > files_,
+                                   PointIndex framesNumber, int maxOpenFiles_,
+                                   shared_ptr<SegmentCache> cache_):
+    files(files_), maxOpenFiles(maxOpenFiles_), fileOpenings(0), cache(cache_),
+    cachedSegment(-1)
+{
+    setSize(framesNumber);
+}
+
+MultiFileDataset::~MultiFileDataset()
+{
+    for (auto& [fileIndex, openFile]: openFiles){
+        closeFile(openFile);
+    }
+}
+
+unique_ptr<Dataset> MultiFileDataset::createCursor()
+{
+    return unique_ptr<Dataset>( new MultiFileDataset(files, size(), maxOpenFiles,
+                                                         cache) );
+}
+
+int MultiFileDataset::getFilesNumber()
+{
+    return files->size();
+}
+
+int MultiFileDataset::findFile(PointIndex pointIndex)
+{
+    // the last file starting at or before the point. Empty files share their startX with
+    // the following file, and are skipped by this.
+    auto next = upper_bound(files->begin(), files->end(), pointIndex,
+                            [](PointIndex x, const FileInfo& info){ return x < info.startX; });
+    return (next - files->begin()) - 1;
+}
+
+SegmentReader& MultiFileDataset::openFile(int fileIndex)
+{
+    auto found = openFilesIndex.find(fileIndex);
+    if (found != openFilesIndex.end()){
+        openFiles.splice(openFiles.begin(), openFiles, found->second);
+        return *found->second->second.reader;
+    }
+
+    if (int(openFiles.size()) >= maxOpenFiles){
+        closeFile(openFiles.back().second);
+        openFilesIndex.erase(openFiles.back().first);
+        openFiles.pop_back();
+    }
+
+    const FileInfo& info = (*files)[fileIndex];
+    OpenFile openFile;
+    {
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        openFile.file.reset( new h5pp::File(info.filename, h5pp::FilePermission::READONLY) );
+    }
+    options::Options& ops = options::OptionsInstance::get();
+    openFile.reader.reset( new SegmentReader(*openFile.file, "features",
+                                             info.usedSegmentsNumber,
+                                             ops.getInt("prefetchDepth", 2)) );
+    fileOpenings++;
+
+    openFiles.emplace_front(fileIndex, std::move(openFile));
+    openFilesIndex[fileIndex] = openFiles.begin();
+    return *openFiles.front().second.reader;
+}
+
+void MultiFileDataset::closeFile(OpenFile& openFile)
+{
+    // The reader locks the HDF5 mutex by itself when it is destroyed.
+    openFile.reader.reset();
+
+    lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+    openFile.file.reset();
+}
+
+void MultiFileDataset::loadSegment(int fileIndex, int segment)
+{
+    const FileInfo& info = (*files)[fileIndex];
+    int globalSegment = info.firstSegment + segment;
+    if (globalSegment != cachedSegment){
+        cachedMatrix = cache->find(globalSegment);
+        if (cachedMatrix == nullptr){
+            RowMajorMatrixXf matrix;
+            openFile(fileIndex).read(segment, matrix);
+            cachedMatrix = cache->insert(globalSegment, matrix);
+        }
+        cachedSegment = globalSegment;
+    }
+}
+
+PointView MultiFileDataset::point(PointIndex pointIndex)
+{
+    assert( pointIndex < size() );
+
+    int fileIndex = findFile(pointIndex);
+    const FileInfo& info = (*files)[fileIndex];
+    PointIndex x = pointIndex - info.startX;
+    loadSegment(fileIndex, x / info.framesPerSegment);
+
+    int frame = x % info.framesPerSegment;
+    return PointView(cachedMatrix->row(frame).data(), cachedMatrix->cols());
+}
+
+BlockView MultiFileDataset::getBlock(PointIndex startX, PointIndex endX)
+{
+    assert( startX < endX && endX <= size() );
+
+    int fileIndex = findFile(startX);
+    const FileInfo& info = (*files)[fileIndex];
+    PointIndex x = startX - info.startX;
+    int segment = x / info.framesPerSegment;
+    // A file ends at a segment boundary, so a block spanning files also spans segments.
+    if ( (endX - 1 - info.startX) / info.framesPerSegment != segment ){
+        return Dataset::getBlock(startX, endX);
+    }
+    loadSegment(fileIndex, segment);
+
+    int frame = x % info.framesPerSegment;
+    return BlockView(cachedMatrix->row(frame).data(), endX - startX, cachedMatrix->cols());
+}
+
+int MultiFileDataset::getBlockLength()
+{
+    return files->front().framesPerSegment;
+}
+
+void MultiFileDataset::printStatistics()
+{
+    cout << "multi-file dataset: " << files->size() << " files, opened "
+         << fileOpenings << " times\n";
+    cache->printStatistics();
+}
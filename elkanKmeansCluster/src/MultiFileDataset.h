@@ -0,0 +1,90 @@
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <h5pp/h5pp.h>
+#include "SegmentReader.h"
+#include "SegmentCache.h"
+#include "cluster/Dataset.h"
+
+// A dataset concatenating the frames of many feature files, in the given order, e.g. all
+// recordings of a corpus. Point indexes are 64-bit, so the dataset may contain more points
+// than an int can count.
+//
+// Only the shapes of the files are read when the dataset is created. A file is opened when
+// its points are first accessed, and at most maxOpenFiles files are kept open; when another
+// file is needed, the least recently used one is closed. Segments of all files share a
+// single cache. All files must have the same number of frames per segment, which is the
+// block length of the dataset.
+class MultiFileDataset: public Dataset{
+public:
+    MultiFileDataset(const std::vector<std::string>& filenames, int maxOpenFiles);
+    ~MultiFileDataset();
+
+    int getFilesNumber();
+
+    PointView point(PointIndex pointIndex) override;
+
+    // A block inside a segment is a view of the cached segment; a block spanning segments
+    // or files is copied.
+    BlockView getBlock(PointIndex startX, PointIndex endX) override;
+    int getBlockLength() override;
+
+    // A cursor shares the shapes of the files and the cache, and has its own open files.
+    std::unique_ptr<Dataset> createCursor() override;
+
+    // print statistics of opening files and caching segments.
+    void printStatistics();
+
+private:
+    // shape of a feature file, and its place in the dataset.
+    struct FileInfo{
+        std::string filename;
+        PointIndex  startX;              // index of the first frame of the file.
+        int         framesPerSegment;
+        int         usedSegmentsNumber;  // number of segments containing used frames.
+        int         firstSegment;        // index of the first segment among all segments.
+    };
+
+    struct OpenFile{
+        std::unique_ptr<h5pp::File>    file;
+        std::unique_ptr<SegmentReader> reader;
+    };
+
+private:
+    // used by createCursor().
+    MultiFileDataset(std::shared_ptr<const std::vector<FileInfo> > files,
+                     PointIndex framesNumber, int maxOpenFiles,
+                     std::shared_ptr<SegmentCache> cache);
+
+    // return the index of the file containing the point.
+    int findFile(PointIndex pointIndex);
+
+    // return the reader of a file, opening the file if necessary.
+    SegmentReader& openFile(int fileIndex);
+    void closeFile(OpenFile& openFile);
+
+    // make sure the given segment of a file is in the cache.
+    void loadSegment(int fileIndex, int segment);
+
+private:
+    // sorted by startX.
+    std::shared_ptr<const std::vector<FileInfo> > files;
+
+    // pool of open files. The most recently used file is at the front.
+    int maxOpenFiles;
+    typedef std::list< std::pair<int, OpenFile> > OpenFileList;
+    OpenFileList openFiles;
+    std::unordered_map<int, OpenFileList::iterator> openFilesIndex;
+    long fileOpenings;
+
+    // caching. Segments are identified by their indexes among all segments. The cache is
+    // shared by the dataset and its cursors, within one budget.
+    std::shared_ptr<SegmentCache> cache;
+    // the most recently accessed segment, held until another segment is accessed, so that
+    // views of it stay valid even if it is evicted by a cursor.
+    int cachedSegment;
+    SegmentCache::Matrix cachedMatrix;
+};
@@ -1,4 +1,7 @@
+#include <memory>
 #include <h5pp/h5pp.h>
+#include "SegmentReader.h"
+#include "SegmentCache.h"
 #include "cluster/Dataset.h"
 
 class SegmentsDataset: public Dataset{
@@ -8,7 +11,33 @@ public:
     int getSegmentsNumber();
     void getSegmentRange(int segmentID, int& startX, int& endX);
 
-    Eigen::RowVectorXf operator()(int pointIndex) override;
+    PointView point(PointIndex pointIndex) override;
+
+    // A block inside a segment is a view of the cached segment; a block spanning segments
+    // is copied.
+    BlockView getBlock(PointIndex startX, PointIndex endX) override;
+    int getBlockLength() override;
+
+    // Points are grouped by segments. Points of a cached segment are copied from the cache,
+    // others are read row by row from the file, without reading their whole segments.
+    void gather(const std::vector<PointIndex>& pointIndexes, RowMajorMatrixXf& points) override;
+
+    // A cursor shares the file and the cache, and has its own reader.
+    std::unique_ptr<Dataset> createCursor() override;
+
+    // print statistics of reading and caching segments.
+    void printStatistics();
+
+private:
+    // used by createCursor().
+    SegmentsDataset(h5pp::File& h5File, int segmentsNumber, int framesPerSegment,
+                    int framesNumber, std::shared_ptr<SegmentCache> cache);
+
+    // create the reader for the used frames.
+    void createReader();
+
+    // make sure the given segment is in the cache.
+    void loadSegment(int segment);
 
 private:
     h5pp::File& h5File;
@@ -16,7 +45,14 @@ private:
     int segmentsNumber;
     int framesPerSegment;
 
-    // caching.
+    // reads segments, prefetching the following ones in background.
+    std::unique_ptr<SegmentReader> reader;
+
+    // caching. Matrixes are row-major, so that a frame can be returned as a view. The
+    // cache is shared by the dataset and its cursors, within one budget.
+    std::shared_ptr<SegmentCache> cache;
+    // the most recently accessed segment, held until another segment is accessed, so that
+    // views of it stay valid even if it is evicted by a cursor.
     int cachedSegment;
-    Eigen::MatrixXf cachedMatrix;
+    SegmentCache::Matrix cachedMatrix;
 };
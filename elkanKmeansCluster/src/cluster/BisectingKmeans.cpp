@@ -0,0 +1,142 @@
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <nanotimer.h>
+#include "BisectingKmeans.h"
+#include "SubsetDataset.h"
+
+using namespace std;
+
+BisectingKmeans::BisectingKmeans(Dataset& dataset_, int K_, int threadsNumber_,
+                                 ClustererFactory createClusterer_):
+    dataset(dataset_)
+{
+    N = dataset.size();
+    K = std::max(1, std::min(K_, int(numeric_limits<uint16_t>::max()) + 1));
+    threadsNumber = std::max(1, threadsNumber_);
+    createClusterer = createClusterer_;
+}
+
+bool BisectingKmeans::split(const Cluster& cluster, unsigned seed, Cluster children[2])
+{
+    if (cluster.pointIndexes->size() < 2){
+        return false;
+    }
+
+    // Starting threads costs more than clustering a small cluster, so small clusters are
+    // split by fewer threads.
+    const PointIndex pointsPerThread = 16384;
+    int splitThreadsNumber = std::min<PointIndex>(threadsNumber,
+                                                  cluster.pointIndexes->size() / pointsPerThread + 1);
+
+    SubsetDataset subset(dataset, cluster.pointIndexes);
+    unique_ptr<KmeansClusterer> clusterer = createClusterer(subset, splitThreadsNumber, seed);
+    clusterer->setVerbose(false);
+    clusterer->cluster();
+    numberOfDistanceCalculation += clusterer->getTotalNumberOfDistanceCalculation();
+
+    const vector<RowVectorXf>& subsetCenters = clusterer->getCenters();
+    const vector<uint16_t>& subsetAssignments = clusterer->getAssignments();
+    for (int c=0; c<2; c++){
+        children[c].inertia = 0.0;
+        children[c].pointIndexes = make_shared< vector<PointIndex> >();
+    }
+    const int blockLength = subset.getBlockLength();
+    for (PointIndex startX=0; startX<subset.size(); startX+=blockLength){
+        PointIndex endX = std::min(startX + blockLength, subset.size());
+        BlockView block = subset.getBlock(startX, endX);
+        for (PointIndex i=startX; i<endX; i++){
+            Cluster& child = children[ subsetAssignments[i] ];
+            child.pointIndexes->push_back( (*cluster.pointIndexes)[i] );
+            child.inertia += (block.row(i - startX) -
+                              subsetCenters[ subsetAssignments[i] ]).squaredNorm();
+        }
+    }
+
+    // all points are the same, so one child is empty.
+    if (children[0].pointIndexes->empty() || children[1].pointIndexes->empty()){
+        return false;
+    }
+
+    for (int c=0; c<2; c++){
+        children[c].node = tree.addNode(subsetCenters[c]);
+    }
+    tree.setChildren(cluster.node, children[0].node, children[1].node);
+    return true;
+}
+
+void BisectingKmeans::cluster(unsigned seed)
+{
+    nanotimer timer;
+    timer.start();
+    numberOfDistanceCalculation = 0;
+
+    // the root is the cluster of all points.
+    Cluster root;
+    root.node = 0;
+    root.inertia = 0.0;
+    root.pointIndexes = make_shared< vector<PointIndex> >(N);
+    Eigen::RowVectorXd sum = Eigen::RowVectorXd::Zero(dataset.point(0).cols());
+    for (PointIndex x=0; x<N; x++){
+        (*root.pointIndexes)[x] = x;
+        sum += dataset.point(x).cast<double>();
+    }
+    tree = CenterTree();
+    tree.addNode( (sum / N).cast<float>() );
+
+    // split the cluster with the largest inertia first.
+    auto lessInertia = [](const Cluster& a, const Cluster& b){ return a.inertia < b.inertia; };
+    priority_queue<Cluster, vector<Cluster>, decltype(lessInertia)> splittable(lessInertia);
+    vector<Cluster> leaves;
+    splittable.push(root);
+
+    int splitsNumber = 0;
+    while ( !splittable.empty() && int(splittable.size() + leaves.size()) < K ){
+        Cluster cluster = splittable.top();
+        splittable.pop();
+
+        Cluster children[2];
+        if ( split(cluster, seed + splitsNumber, children) ){
+            splittable.push(children[0]);
+            splittable.push(children[1]);
+            splitsNumber++;
+        }else{
+            leaves.push_back(cluster);
+        }
+    }
+    while ( !splittable.empty() ){
+        leaves.push_back( splittable.top() );
+        splittable.pop();
+    }
+
+    // number the leaves, and assign their points.
+    centers.resize(leaves.size());
+    assignments.resize(N);
+    for (int leaf=0; leaf<int(leaves.size()); leaf++){
+        tree.setLeaf(leaves[leaf].node, leaf);
+        centers[leaf] = tree.getCenter(leaves[leaf].node);
+        for (PointIndex x: *leaves[leaf].pointIndexes){
+            assignments[x] = leaf;
+        }
+    }
+
+    cout << "clustering " << N << " points into " << leaves.size() << " clusters by "
+         << splitsNumber << " splits converged.\n";
+    cout << "total number of distance calculation: " << numberOfDistanceCalculation << "\n";
+    cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+}
+
+const vector<RowVectorXf>& BisectingKmeans::getCenters()
+{
+    return centers;
+}
+
+const vector<uint16_t>& BisectingKmeans::getAssignments()
+{
+    return assignments;
+}
+
+const CenterTree& BisectingKmeans::getTree()
+{
+    return tree;
+}
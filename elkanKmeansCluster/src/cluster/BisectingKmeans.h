@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KmeansClusterer.h"
+#include "CenterTree.h"
+
+// Bisecting k-means. Starting from one cluster of all points, the cluster with the largest
+// sum of squared distances to its center is repeatedly split in two by 2-means, until there
+// are K clusters. Each split costs O(n) distance calculations for its n points, so large K
+// costs O(N log K) per level of splits instead of O(N*K) per iteration, and no K*K matrix of
+// center distances is kept.
+//
+// The splits form a binary tree of centers, whose leaves are the K clusters. Descending the
+// tree to the closer child finds a close leaf of a point with O(log K) distance calculations,
+// e.g. when assigning other points by a saved codebook.
+//
+// A split is clustered by the clusterer created by a factory, from the dataset of the points
+// of the cluster, the number of threads it may use and its seed.
+class BisectingKmeans {
+public:
+    typedef std::function< std::unique_ptr<KmeansClusterer>(Dataset& dataset,
+                                                            int threadsNumber,
+                                                            unsigned seed) > ClustererFactory;
+
+    BisectingKmeans(Dataset& dataset, int K, int threadsNumber,
+                    ClustererFactory createClusterer);
+
+    // split clusters until there are K of them, or no cluster can be split.
+    void cluster(unsigned seed);
+
+    // Shape is (number of leaves). Centers of the leaves.
+    const vector<RowVectorXf>& getCenters();
+
+    // Shape is (N). Leaf of each point.
+    const vector<uint16_t>& getAssignments();
+
+    // the tree of the splits, whose leaves are numbered as the centers.
+    const CenterTree& getTree();
+
+private:
+    // a cluster which may be split.
+    struct Cluster{
+        int node;
+        double inertia;
+        std::shared_ptr< vector<PointIndex> > pointIndexes;
+    };
+
+    // split a cluster by 2-means. Return false if it cannot be split.
+    bool split(const Cluster& cluster, unsigned seed, Cluster children[2]);
+
+private:
+    Dataset& dataset;
+    PointIndex N;
+    int K;
+    int threadsNumber;
+    ClustererFactory createClusterer;
+
+    // The first node is the root.
+    CenterTree tree;
+
+    vector<RowVectorXf> centers;
+    vector<uint16_t> assignments;
+
+    // debug. how many point-center calculations are performed by all splits.
+    long numberOfDistanceCalculation;
+};
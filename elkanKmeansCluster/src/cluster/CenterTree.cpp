@@ -0,0 +1,133 @@
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "CenterTree.h"
+
+using namespace std;
+
+CenterTree::CenterTree()
+{
+}
+
+CenterTree::CenterTree(const RowMajorMatrixXf& centers, const RowMajorMatrixXi& children,
+                       const vector<int>& leaves)
+{
+    assert( children.rows() == centers.rows() && children.cols() == 2 );
+    assert( PointIndex(leaves.size()) == centers.rows() );
+    for (int node=0; node<centers.rows(); node++){
+        nodes.push_back( Node{centers.row(node), {children(node, 0), children(node, 1)},
+                              leaves[node]} );
+    }
+}
+
+int CenterTree::addNode(const RowVectorXf& center)
+{
+    nodes.push_back( Node{center, {-1, -1}, -1} );
+    return nodes.size() - 1;
+}
+
+void CenterTree::setChildren(int node, int child0, int child1)
+{
+    nodes[node].children[0] = child0;
+    nodes[node].children[1] = child1;
+}
+
+void CenterTree::setLeaf(int node, int leaf)
+{
+    nodes[node].leaf = leaf;
+}
+
+int CenterTree::getNodesNumber() const
+{
+    return nodes.size();
+}
+
+const RowVectorXf& CenterTree::getCenter(int node) const
+{
+    return nodes[node].center;
+}
+
+void CenterTree::getNodes(RowMajorMatrixXf& centers, RowMajorMatrixXi& children,
+                          vector<int>& leaves) const
+{
+    const int nodesNumber = nodes.size();
+    centers.resize(nodesNumber, nodesNumber > 0 ? nodes[0].center.cols() : 0);
+    children.resize(nodesNumber, 2);
+    leaves.resize(nodesNumber);
+    for (int node=0; node<nodesNumber; node++){
+        centers.row(node) = nodes[node].center;
+        children(node, 0) = nodes[node].children[0];
+        children(node, 1) = nodes[node].children[1];
+        leaves[node]      = nodes[node].leaf;
+    }
+}
+
+bool CenterTree::isValid(int leavesNumber) const
+{
+    const int nodesNumber = nodes.size();
+    if (nodesNumber == 0){
+        return false;
+    }
+    // Children have larger indexes than their parents, so descending always ends.
+    for (int node=0; node<nodesNumber; node++){
+        const Node& n = nodes[node];
+        if (n.leaf >= 0){
+            if (n.leaf >= leavesNumber || n.children[0] != -1 || n.children[1] != -1){
+                return false;
+            }
+        }else{
+            for (int child: n.children){
+                if (child <= node || child >= nodesNumber){
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int CenterTree::findLeafNode(const PointView& point, float& squaredDistance,
+                             long& numberOfDistanceCalculation) const
+{
+    int node = 0;
+    squaredDistance = -1.0;
+    while (nodes[node].leaf < 0){
+        const Node& parent = nodes[node];
+        float distance0 = (point - nodes[ parent.children[0] ].center).squaredNorm();
+        float distance1 = (point - nodes[ parent.children[1] ].center).squaredNorm();
+        numberOfDistanceCalculation += 2;
+        node = (distance0 <= distance1) ? parent.children[0] : parent.children[1];
+        squaredDistance = std::min(distance0, distance1);
+    }
+    // the root is a leaf.
+    if (squaredDistance < 0){
+        squaredDistance = (point - nodes[node].center).squaredNorm();
+        numberOfDistanceCalculation++;
+    }
+    return node;
+}
+
+uint16_t CenterTree::findLeaf(const PointView& point) const
+{
+    float squaredDistance;
+    long numberOfDistanceCalculation = 0;
+    return nodes[ findLeafNode(point, squaredDistance, numberOfDistanceCalculation) ].leaf;
+}
+
+void CenterTree::assign(Dataset& dataset, PointIndex startX, PointIndex endX,
+                        uint16_t* assignments, float* distances,
+                        long& numberOfDistanceCalculation) const
+{
+    const int blockLength = dataset.getBlockLength();
+    for (PointIndex blockStartX=startX; blockStartX<endX; blockStartX+=blockLength){
+        PointIndex blockEndX = std::min(blockStartX + blockLength, endX);
+        BlockView block = dataset.getBlock(blockStartX, blockEndX);
+        for (PointIndex x=blockStartX; x<blockEndX; x++){
+            PointView point(block.row(x - blockStartX).data(), block.cols());
+            float squaredDistance;
+            int node = findLeafNode(point, squaredDistance, numberOfDistanceCalculation);
+            assignments[x - startX] = nodes[node].leaf;
+            distances[x - startX]   = sqrt(squaredDistance);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Dataset.h"
+
+using std::vector;
+using Eigen::RowVectorXf;
+
+typedef Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXi;
+
+// A binary tree of centers, e.g. of the splits of bisecting k-means, whose leaves are the
+// centers of clusters. Descending the tree to the closer child finds a close leaf of a point
+// with O(log K) distance calculations; it is not always the closest leaf, as in any tree of
+// centers.
+//
+// The tree is read-only after it is built, so one tree can be used by several threads at the
+// same time.
+class CenterTree {
+public:
+    // an empty tree.
+    CenterTree();
+
+    // a tree of saved nodes, in the shapes of getNodes().
+    CenterTree(const RowMajorMatrixXf& centers, const RowMajorMatrixXi& children,
+               const vector<int>& leaves);
+
+    // Add a node without children, which is an inner node until setLeaf() is called. The
+    // first node is the root. Return the index of the node.
+    int addNode(const RowVectorXf& center);
+    void setChildren(int node, int child0, int child1);
+    void setLeaf(int node, int leaf);
+
+    int getNodesNumber() const;
+    const RowVectorXf& getCenter(int node) const;
+
+    // Copy the nodes. Shapes are (number of nodes, vectorDimension), (number of nodes, 2) and
+    // (number of nodes). Children of a leaf are -1, and the leaf of an inner node is -1.
+    void getNodes(RowMajorMatrixXf& centers, RowMajorMatrixXi& children,
+                  vector<int>& leaves) const;
+
+    // whether the nodes form a tree whose leaves are numbered in [0, leavesNumber), each
+    // child having a larger index than its parent.
+    bool isValid(int leavesNumber) const;
+
+    // find a close leaf by descending the tree.
+    uint16_t findLeaf(const PointView& point) const;
+
+    // assign the points in [startX, endX) of the dataset to leaves found by findLeaf(), as
+    // KmeansAssigner::assign(). distances receive the distances to the leaf centers.
+    void assign(Dataset& dataset, PointIndex startX, PointIndex endX,
+                uint16_t* assignments, float* distances,
+                long& numberOfDistanceCalculation) const;
+
+private:
+    struct Node{
+        RowVectorXf center;
+        int children[2];   // -1 for a leaf.
+        int leaf;          // index of the leaf, or -1 for an inner node.
+    };
+
+    // return the leaf node found for the point, and its squared distance to the point.
+    int findLeafNode(const PointView& point, float& squaredDistance,
+                     long& numberOfDistanceCalculation) const;
+
+private:
+    vector<Node> nodes;
+};
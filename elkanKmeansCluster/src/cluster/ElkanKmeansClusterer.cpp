@@ -1,149 +1,68 @@
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 #include <cassert>
-#include <set>
-#include <algorithm>
-#include <random>
-#include <options.h>
-#include <nanotimer.h>
 #include "ElkanKmeansClusterer.h"
-#include "matplot/matplot.h"
-#include "matrixConversion.h"
 
 using namespace std;
 using namespace Eigen;
 
-ElkanKmeansClusterer::ElkanKmeansClusterer(Dataset& dataset_, int K_):
-    dataset(dataset_)
-{
-    vectorDimension = dataset(0).cols();
-    N = dataset.size();
-    K = K_;
-
-    centersDistances.resize(K, K);
-    closestCenterToCenterDistance.resize(K);
-
-    lowerBounds.resize(N, K);
-    upperBounds.resize(N);
-
-    assignments.resize(N);
-    centers.resize(K);
-}
-
-float ElkanKmeansClusterer::pointToCenterDistance(int pointIndex, uint16_t center) const
-{
-    RowVectorXf diff = dataset(pointIndex) - centers[center];
-    return diff.norm();
-}
-
-float ElkanKmeansClusterer::centerToCenterDistance(uint16_t center1, uint16_t center2) const
+// Convert to the closest float not above the value.
+static float roundDownToFloat(double value)
 {
-    RowVectorXf diff = centers[center1] - centers[center2];
-    return diff.norm();
-}
-
-float ElkanKmeansClusterer::centerToNewCenterDistance(uint16_t center,
-                                    const RowVectorXf& newCenter) const
-{
-    RowVectorXf diff = centers[center] - newCenter;
-    return diff.norm();
-}
-
-const vector< Eigen::RowVectorXf>& ElkanKmeansClusterer::getCenters()
-{
-    return centers;
-}
-
-const vector<uint16_t>& ElkanKmeansClusterer::getAssignments()
-{
-    return assignments;
+    float f = value;
+    if (f > value){
+        f = std::nextafter(f, -numeric_limits<float>::infinity());
+    }
+    return f;
 }
 
-vector<int> ElkanKmeansClusterer::getClusterSizes()
+// Convert to the closest half not above the value. Half floats order like sign-magnitude
+// integers, so the next smaller one is a step of their bits.
+static half roundDownToHalf(float value)
 {
-    vector<int> clusterSizes(K, 0);
-    for (int x=0; x<N; x++){
-        uint16_t cx = assignments[x];
-        clusterSizes[cx]++;
+    half h(value);
+    if (float(h) > value){
+        uint16_t bits = numext::bit_cast<uint16_t>(h);
+        bits = (bits & 0x8000) ? bits + 1 : (bits == 0 ? 0x8001 : bits - 1);
+        h = numext::bit_cast<half>(bits);
     }
-
-    return clusterSizes;
+    return h;
 }
 
-void ElkanKmeansClusterer::printStatus()
+// Convert to the closest half not below the value.
+static half roundUpToHalf(float value)
 {
-    cout << "centers and their info:\n";
-    vector<int> clusterSizes = getClusterSizes();
-    for (int c=0; c<K; c++){
-        cout << c << ": " << centers[c] << "\n"
-             << "  cluster size: " << clusterSizes[c] << "\n";
+    half h(value);
+    if (float(h) < value){
+        uint16_t bits = numext::bit_cast<uint16_t>(h);
+        bits = (bits & 0x8000) ? (bits == 0x8000 ? 0x0001 : bits - 1) : bits + 1;
+        h = numext::bit_cast<half>(bits);
     }
-    cout << "\n";
-
-    cout << "data points and their info:\n";
-    for (int x=0; x<N; x++){
-        uint16_t cx = assignments[x];
-        float assignmentDistance = pointToCenterDistance(x, cx);
-        cout << x << ": " << dataset(x) << "\n"
-             << "  assignment: " << cx << "\n"
-             << "  assignmentDistance: " << assignmentDistance  << "\n";
-    }
-    cout << "\n";
+    return h;
 }
 
-void ElkanKmeansClusterer::draw() const
+ElkanKmeansClusterer::ElkanKmeansClusterer(Dataset& dataset, int K, int threadsNumber,
+                                           bool halfPrecisionBounds_):
+    KmeansClusterer(dataset, K, threadsNumber)
 {
-    using namespace matplot;
-
-    hold(on);
-    xlim({-1, 1});
-    ylim({-1, 1});
-
-    // show data points.
-    vector<double> x;
-    vector<double> y;
-    vector<double> size;
-    vector<double> color;
-    for (int pointIndex = 0; pointIndex < dataset.size(); pointIndex++){
-        Eigen::RowVectorXf point = dataset(pointIndex);
-        x.push_back(point[0]);
-        y.push_back(point[1]);
-        size.push_back(4);
-        color.push_back(assignments[pointIndex]);
-    }
-    scatter( x, y, size, color);
+    centersDistances.resize(K, K);
+    closestCenterToCenterDistance.resize(K);
 
-    // show centers.
-    x.clear(); y.clear(); size.clear(); color.clear();    
-    for (int c=0; c<K; c++){
-        x.push_back(centers[c][0]);
-        y.push_back(centers[c][1]);
-        size.push_back(20);
-        color.push_back(c);
+    halfPrecisionBounds = halfPrecisionBounds_;
+    if (halfPrecisionBounds){
+        halfLowerBounds.resize(N, K);
+        halfUpperBounds.resize(N);
+    }else{
+        lowerBounds.resize(N, K);
+        upperBounds.resize(N);
     }
-    auto l = scatter( x, y, size, color);
-    l->marker_style(line_spec::marker_style::cross);
-
-    show();
 }
 
-void ElkanKmeansClusterer::setInitialCenters()
+long ElkanKmeansClusterer::getBoundsMemory()
 {
-    default_random_engine engine;
-    uniform_int_distribution<int> uniformDist(0, N - 1);
-    set<int> chosenIndexes;
-
-    centers.resize(K);
-    for (int c=0; c<K; c++){
-        // get a random but unseen index.
-        int randomPointIndex;
-        do{
-            randomPointIndex = uniformDist(engine);
-        }while ( chosenIndexes.count(randomPointIndex)>0 );
-
-        chosenIndexes.insert(randomPointIndex);
-        centers[c] = dataset(randomPointIndex);
-    }
+    return (lowerBounds.size() + upperBounds.size()) * sizeof(float) +
+           (halfLowerBounds.size() + halfUpperBounds.size()) * sizeof(half);
 }
 
 void ElkanKmeansClusterer::calculateCentersDistances()
@@ -169,182 +88,247 @@ void ElkanKmeansClusterer::calculateClosestCenterToCenterDistances()
     }
 }
 
-void ElkanKmeansClusterer::calculateInitialAssignment()
+float ElkanKmeansClusterer::getUpperBound(PointIndex x)
 {
-    calculateCentersDistances();
-    for (int x=0; x<N; x++){
-        // Initially assign the first center as the closest.
-        uint16_t cx = 0;
-        float minDistance  = pointToCenterDistance(x, cx);
-        lowerBounds(x, cx) = minDistance;
-
-        // find the closest center.
-        for (int c=1; c<K; c++){
-            // computation avoided if the center is too far from the current assignment.
-            if ( centersDistances(c, cx) > 2 * minDistance){
-                continue;
-            }
-
-            float distance = pointToCenterDistance(x, c);
-            lowerBounds(x, c) = distance;
-            if (distance < minDistance){
-                cx = c;
-                minDistance = distance;
-            }
-        }
+    return halfPrecisionBounds ? float(halfUpperBounds[x]) : upperBounds[x];
+}
 
-        // store its assignment.
-        assignments[x] = cx;
-        upperBounds[x] = minDistance;
+void ElkanKmeansClusterer::setUpperBound(PointIndex x, float bound)
+{
+    if (halfPrecisionBounds){
+        halfUpperBounds[x] = roundUpToHalf(bound);
+    }else{
+        upperBounds[x] = bound;
     }
 }
 
-void ElkanKmeansClusterer::calculateNewCenters(vector<RowVectorXf>& newCenters)
+double ElkanKmeansClusterer::getLowerBound(PointIndex x, int c)
 {
-    // The new centers first act as an accumulating vector.
-    newCenters.resize(K);
-    for (int c=0; c<K; c++){
-        newCenters[c].resize(vectorDimension);
-        newCenters[c].fill(0.0);
-    }
+    float stored = halfPrecisionBounds ? float(halfLowerBounds(x,c)) : lowerBounds(x,c);
+    return stored - centerDrifts[c];
+}
 
-    // accumulate the data points to the centers.
-    vector<int> clustersSizes(K, 0);
-    for (int x=0; x<N; x++){
-        int cx = assignments[x];
-        clustersSizes[cx]++;
-        newCenters[cx] += dataset(x);
+void ElkanKmeansClusterer::setLowerBound(PointIndex x, int c, float distance)
+{
+    float stored = roundDownToFloat(distance + centerDrifts[c]);
+    if (halfPrecisionBounds){
+        halfLowerBounds(x,c) = roundDownToHalf(stored);
+    }else{
+        lowerBounds(x,c) = stored;
     }
+}
 
-    // dividing by cluster sizes to produce new centers.
-    for (int c=0; c<K; c++){
-        newCenters[c] /= clustersSizes[c];
+void ElkanKmeansClusterer::setWarmStart(const RowMajorMatrixXf& centers,
+                                        const vector<uint16_t>& knownAssignments,
+                                        const RowVectorXf& upperBounds,
+                                        const RowMajorMatrixXf& lowerBounds)
+{
+    const PointIndex knownN = knownAssignments.size();
+    assert(knownN <= N);
+    assert(upperBounds.size() == 0 || upperBounds.size() == knownN);
+    assert(lowerBounds.size() == 0 || (lowerBounds.rows() == knownN &&
+                                       lowerBounds.cols() == K));
+
+    setSeedCenters(centers);
+    knownPointsNumber = knownN;
+    std::copy(knownAssignments.begin(), knownAssignments.end(), assignments.begin());
+
+    warmUpperBounds = upperBounds;
+    warmLowerBounds = lowerBounds;
+}
+
+void ElkanKmeansClusterer::getBounds(RowVectorXf& upperBounds, RowMajorMatrixXf& lowerBounds)
+{
+    upperBounds.resize(N);
+    lowerBounds.resize(N, K);
+    for (PointIndex x=0; x<N; x++){
+        upperBounds[x] = getUpperBound(x);
+        for (int c=0; c<K; c++){
+            lowerBounds(x,c) = roundDownToFloat( getLowerBound(x,c) );
+        }
     }
 }
 
-void ElkanKmeansClusterer::runOneIteration()
+void ElkanKmeansClusterer::calculateInitialAssignment()
 {
-    assignmentChanged = false;
-    numberOfDistanceCalculation = 0;
+    centerDrifts.assign(K, 0.0);
 
-    // step 1.
-    calculateCentersDistances();
-    calculateClosestCenterToCenterDistances();
+    // Points whose bounds are given by a warm start keep them, and are not read.
+    const PointIndex warmPointsNumber = warmUpperBounds.size();
+    auto copyWarmBounds = [&](PointIndex x){
+        setUpperBound(x, warmUpperBounds[x]);
+        for (int c=0; c<K; c++){
+            setLowerBound(x, c, warmLowerBounds(x,c));
+        }
+    };
+
+    // The first pass calculates all distances, so they are calculated block by block by
+    // matrix products.
+    RowMajorMatrixXf centersMatrix;
+    getCentersMatrix(centersMatrix);
+    forEachThreadRange([&](int thread, PointIndex threadStartX, PointIndex threadEndX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        const int blockLength = threadDataset.getBlockLength();
+        RowMajorMatrixXf distances;
+        for (PointIndex startX=threadStartX; startX<threadEndX; startX+=blockLength){
+            PointIndex endX = std::min(startX + blockLength, threadEndX);
+            if (endX <= warmPointsNumber){
+                for (PointIndex x=startX; x<endX; x++){
+                    copyWarmBounds(x);
+                }
+                continue;
+            }
+
+            BlockView block = threadDataset.getBlock(startX, endX);
+            blockToCentersLowerDistances(block, centersMatrix, distances);
+
+            for (PointIndex x=startX; x<endX; x++){
+                if (x < warmPointsNumber){
+                    copyWarmBounds(x);
+                    continue;
+                }
+
+                auto pointDistances = distances.row(x - startX);
+                for (int c=0; c<K; c++){
+                    setLowerBound(x, c, pointDistances[c]);
+                }
+
+                // assign the center with the smallest bound, unless the assignment is
+                // known. Its exact distance is the upper bound; if another center is in
+                // fact closer, the first iteration will find it.
+                Eigen::Index cx = assignments[x];
+                if (x >= knownPointsNumber){
+                    pointDistances.minCoeff(&cx);
+                }
+                PointView point(block.row(x - startX).data(), vectorDimension);
+                float distance = pointToCenterDistance(point, cx);
+                setLowerBound(x, cx, distance);
+
+                // store its assignment.
+                assignments[x] = cx;
+                setUpperBound(x, distance);
+            }
+        }
+    });
 
-    for (int x=0; x<N; x++){
+    warmUpperBounds.resize(0);
+    warmLowerBounds.resize(0, 0);
+}
+
+void ElkanKmeansClusterer::assignPoints(int thread, PointIndex startX, PointIndex endX)
+{
+    Dataset& threadDataset = *threadDatasets[thread];
+    ThreadState& state = threadStates[thread];
+
+    for (PointIndex x=startX; x<endX; x++){
         // step 2
-        int cx = assignments[x];
-        if ( upperBounds[x] <= closestCenterToCenterDistance[cx] ){
+        const uint16_t previousAssignment = assignments[x];
+        int cx = previousAssignment;
+        float upperBound = getUpperBound(x);
+        if ( upperBound <= closestCenterToCenterDistance[cx] ){
             // all other centers are too far away from the current assignment, so
             // should keep the current assignment.
             continue;
         }
 
-        // step 3
-        //nanotimer timer;
-        //timer.start();
+        // step 3. The point is read only when a distance has to be calculated, so that the
+        // points whose bounds hold, e.g. most points of a warm start, are not read from a
+        // dataset reading files. The view is remapped by placement new, as Eigen allows.
+        PointView point(nullptr, vectorDimension);
         float distanceToCurrentAssignment;
         bool hasCalculatedDistanceToCurrentAssignment = false;
         for (int c=0; c<K; c++){
             if (c==cx) continue;
-            if (upperBounds[x] < lowerBounds(x,c) ||
-                upperBounds[x] < 0.5 * centersDistances(cx, c) ){
+            if (upperBound < getLowerBound(x,c) ||
+                upperBound < 0.5 * centersDistances(cx, c) ){
                 // the calculation d(x,c) can be avoided.
                 continue;
             }
 
             // calculate distance to the current assignment.
             if ( ! hasCalculatedDistanceToCurrentAssignment ){
-                distanceToCurrentAssignment = pointToCenterDistance(x, cx);
-                upperBounds[x]    = distanceToCurrentAssignment;
-                lowerBounds(x,cx) = distanceToCurrentAssignment;
+                new (&point) PointView(threadDataset.point(x).data(), vectorDimension);
+                distanceToCurrentAssignment = pointToCenterDistance(point, cx);
+                upperBound = distanceToCurrentAssignment;
+                setLowerBound(x, cx, distanceToCurrentAssignment);
 
                 hasCalculatedDistanceToCurrentAssignment = true;
             }
 
             // calculate d(x,c).
-            float distance = pointToCenterDistance(x,c);
-            lowerBounds(x,c) = distance;
-            numberOfDistanceCalculation++;
+            float distance = pointToCenterDistance(point, c);
+            setLowerBound(x, c, distance);
+            state.numberOfDistanceCalculation++;
 
             if (distance < distanceToCurrentAssignment){
                 // change assignment.
                 cx = c;
                 assignments[x] = cx;
                 distanceToCurrentAssignment = distance;
+                upperBound = distance;
 
-                assignmentChanged = true;
+                state.assignmentChanged = true;
             }
         }
-        //cout << "step 3 spent: " << timer.get_elapsed_us() << "\n";
 
-        // step 4
-        //timer.start();
-        vector<RowVectorXf> newCenters;
-        calculateNewCenters(newCenters);
-        vector<float> centerMovements(K);
-        for (int c=0; c<K; c++){
-            centerMovements[c] = centerToNewCenterDistance(c, newCenters[c] );
-        }
-        //cout << "step 4 spent: " << timer.get_elapsed_us() << "\n";
-
-        // step 5
-        //timer.start();
-        for (int x=0; x<N; x++){
-            for (int c=0; c<K; c++){
-                lowerBounds(x,c) = std::max(0.0f, lowerBounds(x,c) - centerMovements[c] );
-            }
+        if (hasCalculatedDistanceToCurrentAssignment){
+            setUpperBound(x, upperBound);
         }
-        //cout << "step 5 spent: " << timer.get_elapsed_us() << "\n";
 
-        // step 6.
-        for (int x=0; x<N; x++){
-            uint16_t cx = assignments[x];
-            upperBounds[x] += centerMovements[cx];
+        // keep the sums of clusters up to date.
+        if (cx != previousAssignment){
+            moveAssignment(thread, point, previousAssignment, cx);
         }
+    }
+}
 
-        // step 7.
-        centers = newCenters;
-
-        // report progress.
-        if (N>1000){
-            if ( (x+1) % (300) == 0){
-                cout << "processing data point " << x << " of " << N
-                     << " (" << int( float(x*100)/N) << "%)\n";
-            }
-        }
+void ElkanKmeansClusterer::updateBounds(PointIndex startX, PointIndex endX,
+                                        const RowVectorXf& centerMovements)
+{
+    // step 6.
+    for (PointIndex x=startX; x<endX; x++){
+        uint16_t cx = assignments[x];
+        setUpperBound(x, getUpperBound(x) + centerMovements[cx]);
     }
 }
 
-void ElkanKmeansClusterer::cluster()
+void ElkanKmeansClusterer::runOneIteration()
 {
-    nanotimer timer;
-    timer.start();
-
-    // preparation.
-    // Randomly select some data points as initial centers.
-    setInitialCenters();
-    // initialize lower bounds.
-    for (int x=0; x<N; x++){
-        for (int c=0; c<K; c++){
-            lowerBounds(x, c) = 0.0;
-        }
+    // step 1.
+    calculateCentersDistances();
+    calculateClosestCenterToCenterDistances();
+
+    // step 2 and 3.
+    //nanotimer timer;
+    //timer.start();
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        assignPoints(thread, startX, endX);
+    });
+    reduceThreadStates();
+    //cout << "step 3 spent: " << timer.get_elapsed_us() << "\n";
+
+    // step 4
+    //timer.start();
+    vector<RowVectorXf> newCenters;
+    calculateNewCenters(newCenters);
+    RowVectorXf centerMovements(K);
+    for (int c=0; c<K; c++){
+        centerMovements[c] = centerToNewCenterDistance(c, newCenters[c] );
     }
-    calculateInitialAssignment();
-
-    // iterations.
-    int totalNumberOfDistanceCalculation = 0;
-    for (int iteration=0; ; iteration++){
-        cout << "==== iteration #" << iteration << " ====\n";
-        runOneIteration();        
-        cout << "numberOfDistanceCalculation = " << numberOfDistanceCalculation << "\n";
-        totalNumberOfDistanceCalculation += numberOfDistanceCalculation;
-        if (! assignmentChanged ) break;
+    //cout << "step 4 spent: " << timer.get_elapsed_us() << "\n";
+
+    // step 5. Lower bounds are decreased by the drifts when they are read.
+    for (int c=0; c<K; c++){
+        centerDrifts[c] += centerMovements[c];
     }
-    //printStatus();
-    //draw();
-    cout << "clustering converged.\n";
-    cout << "total number of distance calculation: " << totalNumberOfDistanceCalculation << "\n";
 
-    cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+    // step 6.
+    //timer.start();
+    forEachThreadRange([&](int, PointIndex startX, PointIndex endX){
+        updateBounds(startX, endX, centerMovements);
+    });
+    //cout << "step 6 spent: " << timer.get_elapsed_us() << "\n";
+
+    // step 7.
+    centers = newCenters;
 }
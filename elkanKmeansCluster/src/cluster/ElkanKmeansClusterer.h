@@ -1,41 +1,40 @@
 #pragma once
 
-#include <cstdint>
-#include <limits>
-#include <string>
-#include <vector>
-#include "Dataset.h"
-
-using std::vector;
-using Eigen::RowVectorXf;
-using Eigen::MatrixXf;
-
-class ElkanKmeansClusterer {
+#include "KmeansClusterer.h"
+
+// Elkan's k-means. For each point, it keeps an upper bound of the distance to its center and
+// a lower bound of the distance to every center, so bounds take O(N*K) memory.
+//
+// Lower bounds are decreased lazily: each center accumulates its movements in a drift, and
+// the stored bound of a point is its lower bound plus the drift of the center at that time.
+// Moving the centers then updates K drifts instead of N*K bounds.
+//
+// Bounds can be stored in half precision to halve their memory. Lower bounds are rounded
+// down and upper bounds up, so the pruning is still exact, only less effective.
+class ElkanKmeansClusterer: public KmeansClusterer {
 public:
-    ElkanKmeansClusterer(Dataset& dataset, int K_);
+    ElkanKmeansClusterer(Dataset& dataset, int K, int threadsNumber = 1,
+                         bool halfPrecisionBounds = false);
 
-    void cluster();
+    long getBoundsMemory() override;
 
-    const vector<RowVectorXf>& getCenters();
-    const vector<uint16_t>& getAssignments();    
-    vector<int> getClusterSizes();
+    // Start from a previous clustering of the first points of the dataset, to which points
+    // have been appended since: its centers, which must be the means of its clusters as
+    // left by cluster(), the assignments of its points, and optionally their bounds, which
+    // are empty if not saved. Only the appended points are assigned from scratch, and
+    // without bounds, the distances of the previous points are calculated once.
+    void setWarmStart(const RowMajorMatrixXf& centers, const vector<uint16_t>& assignments,
+                      const RowVectorXf& upperBounds, const RowMajorMatrixXf& lowerBounds);
 
-    // debug functions.
-    void printStatus();
+    // get "u(x)" and "l(x,c)" of all points, which are valid for the current centers, e.g.
+    // to save them for a warm start.
+    void getBounds(RowVectorXf& upperBounds, RowMajorMatrixXf& lowerBounds);
 
-    // Only applicable to two-dimensional data points.
-    void draw() const;
-
-private:
+protected:
     // higher level functions.
-    // randomly select K data points from the database and set them
-    // as the initial centers.
-    void setInitialCenters();
+    void calculateInitialAssignment() override;
 
-    // At the beginning, assign the data points to initial centers.
-    void calculateInitialAssignment();
-
-    void runOneIteration();
+    void runOneIteration() override;
 
 private:
     // middle level functions.
@@ -45,45 +44,53 @@ private:
     // For each center, calculate the closest distance to other centers.
     void calculateClosestCenterToCenterDistances();
 
-    // calculate new centers of the current iteration.
-    void calculateNewCenters(vector<RowVectorXf>& centersMeans);
+    // steps 2 and 3 of an iteration for the points in [startX, endX).
+    void assignPoints(int thread, PointIndex startX, PointIndex endX);
+
+    // step 6 of an iteration for the points in [startX, endX).
+    void updateBounds(PointIndex startX, PointIndex endX, const RowVectorXf& centerMovements);
 
 private:
     // lower level functions.
-    // calculate distance between all pairs of centers.
-    float pointToCenterDistance(int pointIndex, uint16_t center) const;
-    float centerToCenterDistance(uint16_t center1, uint16_t center2) const;
-    float centerToNewCenterDistance(uint16_t center, const RowVectorXf& newCenter) const;
+    // get "u(x)".
+    float getUpperBound(PointIndex x);
 
-private:
-    Dataset& dataset;    
-    int vectorDimension;
-    int N;   // number of data points.
-    int K;   // cluster number.
+    // set "u(x)". The stored bound is rounded up, so that it never underestimates the
+    // distance.
+    void setUpperBound(PointIndex x, float bound);
 
+    // get "l(x,c)" from the stored bound.
+    double getLowerBound(PointIndex x, int c);
+
+    // set "l(x,c)" to a calculated distance. The stored bound is rounded down, so that it
+    // never overestimates the distance.
+    void setLowerBound(PointIndex x, int c, float distance);
+
+private:
     // Shape is (K, K). Stores all "d(c,c')".
     MatrixXf centersDistances;
 
     // Shape is (K). Stores "s(c)".
     RowVectorXf closestCenterToCenterDistance;
 
+    bool halfPrecisionBounds;
+
     // Shape is (N). Stores "u(x)".
     RowVectorXf upperBounds;
 
-    // Shape is (N, K). Stores "l(x,c)".
-    MatrixXf lowerBounds;
-
-    // Shape is (N). For each point in x, keep which cluster it is assigned to. By using a
-    // short, we assume a limited number of clusters (fewer than 2^16).
-    vector<uint16_t> assignments;
+    // Shape is (K). The sum of movements of each center since the initial assignment.
+    // Double, so that the drifts do not lose precision over many iterations.
+    vector<double> centerDrifts;
 
-    // Shape is (K). k-th element is the center of the k-th cluster.
-    vector< RowVectorXf> centers;
+    // Shape is (N, K). Stores "l(x,c)" plus the drift of c. Row-major, as the bounds of a
+    // point are accessed together.
+    RowMajorMatrixXf lowerBounds;
 
-    // whether there is any change of assignment. If so, the cluster has not converged.
-    bool assignmentChanged;
+    // bounds given by setWarmStart(), until the initial assignment.
+    RowVectorXf warmUpperBounds;
+    RowMajorMatrixXf warmLowerBounds;
 
-    // debug. how many point-center calculations are performed.
-    int numberOfDistanceCalculation;
+    // used in place of upperBounds and lowerBounds if bounds are stored in half precision.
+    Eigen::Matrix<Eigen::half, 1, Eigen::Dynamic> halfUpperBounds;
+    Eigen::Matrix<Eigen::half, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> halfLowerBounds;
 };
-
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <algorithm>
+#include "HamerlyKmeansClusterer.h"
+
+using namespace std;
+using namespace Eigen;
+
+HamerlyKmeansClusterer::HamerlyKmeansClusterer(Dataset& dataset, int K, int threadsNumber):
+    KmeansClusterer(dataset, K, threadsNumber)
+{
+    closestCenterToCenterDistance.resize(K);
+
+    lowerBounds.resize(N);
+    upperBounds.resize(N);
+}
+
+long HamerlyKmeansClusterer::getBoundsMemory()
+{
+    return (lowerBounds.size() + upperBounds.size()) * sizeof(float);
+}
+
+void HamerlyKmeansClusterer::calculateClosestCenterToCenterDistances()
+{
+    closestCenterToCenterDistance.fill( numeric_limits<float>::max() );
+    for (int c=0; c<K; c++){
+        for (int k=c+1; k<K; k++){
+            float distance = 0.5 * centerToCenterDistance(c, k);
+            closestCenterToCenterDistance[c] = std::min(closestCenterToCenterDistance[c], distance);
+            closestCenterToCenterDistance[k] = std::min(closestCenterToCenterDistance[k], distance);
+        }
+    }
+}
+
+void HamerlyKmeansClusterer::findTwoClosest(const PointView& point, uint16_t& closest,
+                                            float& closestDistance,
+                                            float& secondClosestDistance,
+                                            long& numberOfDistanceCalculation)
+{
+    const uint16_t known = closest;
+    secondClosestDistance = numeric_limits<float>::max();
+    for (int c=0; c<K; c++){
+        if (c==known) continue;
+
+        float distance = pointToCenterDistance(point, c);
+        numberOfDistanceCalculation++;
+        if (distance < closestDistance){
+            secondClosestDistance = closestDistance;
+            closestDistance = distance;
+            closest = c;
+        }else if (distance < secondClosestDistance){
+            secondClosestDistance = distance;
+        }
+    }
+}
+
+void HamerlyKmeansClusterer::calculateInitialAssignment()
+{
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        for (PointIndex x=startX; x<endX; x++){
+            PointView point = threadDataset.point(x);
+
+            // Initially assign the first center as the closest.
+            uint16_t cx = 0;
+            float closestDistance = pointToCenterDistance(point, cx);
+            float secondClosestDistance;
+            long numberOfDistanceCalculation = 0;
+            findTwoClosest(point, cx, closestDistance, secondClosestDistance,
+                           numberOfDistanceCalculation);
+
+            // store its assignment.
+            assignments[x] = cx;
+            upperBounds[x] = closestDistance;
+            lowerBounds[x] = secondClosestDistance;
+        }
+    });
+}
+
+void HamerlyKmeansClusterer::assignPoints(int thread, PointIndex startX, PointIndex endX)
+{
+    Dataset& threadDataset = *threadDatasets[thread];
+    ThreadState& state = threadStates[thread];
+
+    for (PointIndex x=startX; x<endX; x++){
+        const uint16_t previousAssignment = assignments[x];
+        float bound = std::max(closestCenterToCenterDistance[previousAssignment],
+                               lowerBounds[x]);
+        if ( upperBounds[x] <= bound ){
+            // no other center can be closer than the current assignment.
+            continue;
+        }
+
+        // tighten the upper bound, and test again.
+        PointView point = threadDataset.point(x);
+        upperBounds[x] = pointToCenterDistance(point, previousAssignment);
+        if ( upperBounds[x] <= bound ){
+            continue;
+        }
+
+        // calculate distances to all other centers.
+        uint16_t cx = previousAssignment;
+        float closestDistance = upperBounds[x];
+        float secondClosestDistance;
+        findTwoClosest(point, cx, closestDistance, secondClosestDistance,
+                       state.numberOfDistanceCalculation);
+        upperBounds[x] = closestDistance;
+        lowerBounds[x] = secondClosestDistance;
+
+        if (cx != previousAssignment){
+            assignments[x] = cx;
+            state.assignmentChanged = true;
+
+            // keep the sums of clusters up to date.
+            moveAssignment(thread, point, previousAssignment, cx);
+        }
+    }
+}
+
+void HamerlyKmeansClusterer::updateBounds(PointIndex startX, PointIndex endX,
+                                          const vector<float>& centerMovements)
+{
+    // The lower bound of a point is decreased by the largest movement of the other centers.
+    int farthestMovingCenter = max_element(centerMovements.begin(), centerMovements.end())
+                               - centerMovements.begin();
+    float largestMovement = centerMovements[farthestMovingCenter];
+    float secondLargestMovement = 0.0;
+    for (int c=0; c<K; c++){
+        if (c != farthestMovingCenter){
+            secondLargestMovement = std::max(secondLargestMovement, centerMovements[c]);
+        }
+    }
+
+    for (PointIndex x=startX; x<endX; x++){
+        uint16_t cx = assignments[x];
+        upperBounds[x] += centerMovements[cx];
+        lowerBounds[x] -= (cx == farthestMovingCenter) ? secondLargestMovement : largestMovement;
+    }
+}
+
+void HamerlyKmeansClusterer::runOneIteration()
+{
+    calculateClosestCenterToCenterDistances();
+
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        assignPoints(thread, startX, endX);
+    });
+    reduceThreadStates();
+
+    // move the centers.
+    vector<RowVectorXf> newCenters;
+    calculateNewCenters(newCenters);
+    vector<float> centerMovements(K);
+    for (int c=0; c<K; c++){
+        centerMovements[c] = centerToNewCenterDistance(c, newCenters[c] );
+    }
+
+    forEachThreadRange([&](int, PointIndex startX, PointIndex endX){
+        updateBounds(startX, endX, centerMovements);
+    });
+
+    centers = newCenters;
+}
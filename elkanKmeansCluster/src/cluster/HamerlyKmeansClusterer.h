@@ -0,0 +1,50 @@
+#pragma once
+
+#include "KmeansClusterer.h"
+
+// Hamerly's k-means. For each point, it keeps an upper bound of the distance to its center
+// and a single lower bound of the distance to all other centers, so bounds take O(N) memory,
+// at the cost of pruning fewer distance calculations than Elkan's k-means.
+class HamerlyKmeansClusterer: public KmeansClusterer {
+public:
+    HamerlyKmeansClusterer(Dataset& dataset, int K, int threadsNumber = 1);
+
+    long getBoundsMemory() override;
+
+protected:
+    // higher level functions.
+    void calculateInitialAssignment() override;
+
+    void runOneIteration() override;
+
+private:
+    // middle level functions.
+    // For each center, calculate half of the closest distance to other centers.
+    void calculateClosestCenterToCenterDistances();
+
+    // assign the points in [startX, endX) to their closest centers.
+    void assignPoints(int thread, PointIndex startX, PointIndex endX);
+
+    // update bounds of the points in [startX, endX) after centers move.
+    void updateBounds(PointIndex startX, PointIndex endX, const vector<float>& centerMovements);
+
+private:
+    // lower level functions.
+    // calculate distances from a point to all centers other than the given one, and find
+    // the closest and the second closest among them and the given one, whose distance is
+    // known.
+    void findTwoClosest(const PointView& point, uint16_t& closest,
+                        float& closestDistance, float& secondClosestDistance,
+                        long& numberOfDistanceCalculation);
+
+private:
+    // Shape is (K). Stores "s(c)", half of the distance to the closest other center.
+    RowVectorXf closestCenterToCenterDistance;
+
+    // Shape is (N). Stores "u(x)".
+    RowVectorXf upperBounds;
+
+    // Shape is (N). Stores "l(x)", a lower bound of the distances to all centers except
+    // the assigned one.
+    RowVectorXf lowerBounds;
+};
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cassert>
+#include "KmeansAssigner.h"
+
+using namespace std;
+
+KmeansAssigner::KmeansAssigner(const RowMajorMatrixXf& centers_):
+    centers(centers_)
+{
+    K = centers.rows();
+    assert(K > 0 && K <= 65536);
+
+    centersDistances.resize(K, K);
+    for (int c=0; c<K; c++){
+        for (int k=0; k<K; k++){
+            centersDistances(c, k) = (centers.row(c) - centers.row(k)).norm();
+        }
+    }
+
+    sortedNeighbors.resize(K);
+    for (int c=0; c<K; c++){
+        vector<uint16_t>& neighbors = sortedNeighbors[c];
+        for (int k=0; k<K; k++){
+            if (k != c){
+                neighbors.push_back(k);
+            }
+        }
+        sort(neighbors.begin(), neighbors.end(), [&](uint16_t a, uint16_t b){
+            return centersDistances(c, a) < centersDistances(c, b);
+        });
+    }
+}
+
+void KmeansAssigner::assign(Dataset& dataset, PointIndex startX, PointIndex endX,
+                            uint16_t* assignments, float* distances,
+                            long& numberOfDistanceCalculation) const
+{
+    uint16_t guess = 0;
+    const int blockLength = dataset.getBlockLength();
+    for (PointIndex blockStartX=startX; blockStartX<endX; blockStartX+=blockLength){
+        PointIndex blockEndX = std::min(blockStartX + blockLength, endX);
+        BlockView block = dataset.getBlock(blockStartX, blockEndX);
+        for (PointIndex x=blockStartX; x<blockEndX; x++){
+            auto point = block.row(x - blockStartX);
+
+            const float guessDistance = (point - centers.row(guess)).norm();
+            uint16_t closest = guess;
+            float closestDistance = guessDistance;
+            numberOfDistanceCalculation++;
+            for (uint16_t c: sortedNeighbors[guess]){
+                if ( centersDistances(guess, c) >= 2 * guessDistance ){
+                    // this and all following centers are not closer than the guess.
+                    break;
+                }
+                if ( centersDistances(closest, c) >= 2 * closestDistance ){
+                    continue;
+                }
+
+                float distance = (point - centers.row(c)).norm();
+                numberOfDistanceCalculation++;
+                if (distance < closestDistance){
+                    closest = c;
+                    closestDistance = distance;
+                }
+            }
+
+            assignments[x - startX] = closest;
+            distances[x - startX] = closestDistance;
+            guess = closest;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Dataset.h"
+
+using std::vector;
+
+// Assign data points to the closest of fixed centers, e.g. of a saved codebook, without
+// clustering. Distances between centers are calculated once, and for each center the other
+// centers are sorted by their distances to it.
+//
+// A point is first measured against a guess, the center of the previous point, as
+// consecutive frames are often close. The other centers are then visited from the closest
+// to the guess: once a center is at least twice as far from the guess as the point is, so
+// are all the following ones, and none of them can be closer. A center is also skipped if
+// it is at least twice as far from the best center so far as the point is.
+//
+// The centers are read-only after construction, so one assigner can be used by several
+// threads at the same time.
+class KmeansAssigner {
+public:
+    // Shape of centers is (K, vectorDimension). K must not exceed 2^16.
+    KmeansAssigner(const RowMajorMatrixXf& centers);
+
+    // assign the points in [startX, endX) of the dataset. assignments and distances receive
+    // (endX - startX) values: the closest centers and the distances to them.
+    void assign(Dataset& dataset, PointIndex startX, PointIndex endX,
+                uint16_t* assignments, float* distances,
+                long& numberOfDistanceCalculation) const;
+
+private:
+    RowMajorMatrixXf centers;
+    int K;
+
+    // Shape is (K, K). Stores all "d(c,c')".
+    Eigen::MatrixXf centersDistances;
+
+    // Shape is (K, K-1). For each center, the other centers sorted by distance to it.
+    vector< vector<uint16_t> > sortedNeighbors;
+};
@@ -0,0 +1,384 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <random>
+#include <options.h>
+#include <nanotimer.h>
+#include "KmeansClusterer.h"
+#include "KmeansSeeder.h"
+#include "matplot/matplot.h"
+#include "matrixConversion.h"
+
+using namespace std;
+using namespace Eigen;
+
+KmeansClusterer::KmeansClusterer(Dataset& dataset_, int K_, int threadsNumber_):
+    dataset(dataset_)
+{
+    vectorDimension = dataset.point(0).cols();
+    N = dataset.size();
+    K = K_;
+    threadsNumber = std::max(1, threadsNumber_);
+
+    seeding = UniformSeeding;
+    seed    = default_random_engine::default_seed;
+    verbose = true;
+    knownPointsNumber = 0;
+
+    numberOfDistanceCalculation = 0;
+    totalNumberOfDistanceCalculation = 0;
+    iterationsNumber = 0;
+
+    assignments.resize(N);
+    centers.resize(K);
+
+    threadDatasets.push_back(&dataset);
+    for (int thread=1; thread<threadsNumber; thread++){
+        cursors.push_back( dataset.createCursor() );
+        threadDatasets.push_back( cursors.back().get() );
+    }
+    threadStates.resize(threadsNumber);
+    for (ThreadState& state: threadStates){
+        state.numberOfDistanceCalculation = 0;
+        state.assignmentChanged = false;
+        state.clustersSums.setZero(K, vectorDimension);
+        state.clustersSizes.assign(K, 0);
+    }
+}
+
+void KmeansClusterer::getThreadRange(int thread, PointIndex& startX, PointIndex& endX)
+{
+    const int blockLength = dataset.getBlockLength();
+    PointIndex blocksNumber = (N + blockLength - 1) / blockLength;
+    startX = std::min(N, blocksNumber * thread / threadsNumber * blockLength);
+    endX   = std::min(N, blocksNumber * (thread + 1) / threadsNumber * blockLength);
+}
+
+float KmeansClusterer::pointToCenterDistance(const PointView& point, uint16_t center) const
+{
+    return (point - centers[center]).norm();
+}
+
+float KmeansClusterer::centerToCenterDistance(uint16_t center1, uint16_t center2) const
+{
+    return (centers[center1] - centers[center2]).norm();
+}
+
+float KmeansClusterer::centerToNewCenterDistance(uint16_t center,
+                                    const RowVectorXf& newCenter) const
+{
+    return (centers[center] - newCenter).norm();
+}
+
+void KmeansClusterer::getCentersMatrix(RowMajorMatrixXf& centersMatrix) const
+{
+    centersMatrix.resize(K, vectorDimension);
+    for (int c=0; c<K; c++){
+        centersMatrix.row(c) = centers[c];
+    }
+}
+
+void KmeansClusterer::blockToCentersLowerDistances(const BlockView& block,
+                                                   const RowMajorMatrixXf& centersMatrix,
+                                                   RowMajorMatrixXf& distances) const
+{
+    // The rounding error of the expansion is below (D+2)*u*(|x|+|c|)^2 for D dimensions and
+    // the unit roundoff u, which is half of epsilon.
+    const float errorRatio = (vectorDimension + 2) * numeric_limits<float>::epsilon();
+    Eigen::VectorXf pointsNorms = block.rowwise().norm();
+    RowVectorXf centersNorms = centersMatrix.rowwise().norm().transpose();
+
+    distances.noalias() = block * centersMatrix.transpose();
+    for (Eigen::Index i=0; i<distances.rows(); i++){
+        for (int c=0; c<K; c++){
+            float squaredDistance = pointsNorms[i] * pointsNorms[i] - 2 * distances(i, c)
+                                    + centersNorms[c] * centersNorms[c];
+            float normsSum = pointsNorms[i] + centersNorms[c];
+            float error = errorRatio * normsSum * normsSum;
+            distances(i, c) = std::sqrt( std::max(0.0f, squaredDistance - error) );
+        }
+    }
+}
+
+const vector< Eigen::RowVectorXf>& KmeansClusterer::getCenters()
+{
+    return centers;
+}
+
+const vector<uint16_t>& KmeansClusterer::getAssignments()
+{
+    return assignments;
+}
+
+vector<PointIndex> KmeansClusterer::getClusterSizes()
+{
+    vector<PointIndex> clusterSizes(K, 0);
+    for (PointIndex x=0; x<N; x++){
+        uint16_t cx = assignments[x];
+        clusterSizes[cx]++;
+    }
+
+    return clusterSizes;
+}
+
+int KmeansClusterer::getIterationsNumber()
+{
+    return iterationsNumber;
+}
+
+long KmeansClusterer::getTotalNumberOfDistanceCalculation()
+{
+    return totalNumberOfDistanceCalculation;
+}
+
+double KmeansClusterer::calculateInertia()
+{
+    vector<double> threadSums(threadsNumber, 0.0);
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        double sum = 0.0;
+        for (PointIndex x=startX; x<endX; x++){
+            sum += (threadDataset.point(x) - centers[ assignments[x] ]).squaredNorm();
+        }
+        threadSums[thread] = sum;
+    });
+
+    double inertia = 0.0;
+    for (double sum: threadSums){
+        inertia += sum;
+    }
+    return inertia;
+}
+
+void KmeansClusterer::printStatus()
+{
+    cout << "centers and their info:\n";
+    vector<PointIndex> clusterSizes = getClusterSizes();
+    for (int c=0; c<K; c++){
+        cout << c << ": " << centers[c] << "\n"
+             << "  cluster size: " << clusterSizes[c] << "\n";
+    }
+    cout << "\n";
+
+    cout << "data points and their info:\n";
+    for (PointIndex x=0; x<N; x++){
+        uint16_t cx = assignments[x];
+        float assignmentDistance = pointToCenterDistance(dataset.point(x), cx);
+        cout << x << ": " << dataset.point(x) << "\n"
+             << "  assignment: " << cx << "\n"
+             << "  assignmentDistance: " << assignmentDistance  << "\n";
+    }
+    cout << "\n";
+}
+
+void KmeansClusterer::draw() const
+{
+    using namespace matplot;
+
+    hold(on);
+    xlim({-1, 1});
+    ylim({-1, 1});
+
+    // show data points.
+    vector<double> x;
+    vector<double> y;
+    vector<double> size;
+    vector<double> color;
+    for (PointIndex pointIndex = 0; pointIndex < dataset.size(); pointIndex++){
+        PointView point = dataset.point(pointIndex);
+        x.push_back(point[0]);
+        y.push_back(point[1]);
+        size.push_back(4);
+        color.push_back(assignments[pointIndex]);
+    }
+    scatter( x, y, size, color);
+
+    // show centers.
+    x.clear(); y.clear(); size.clear(); color.clear();    
+    for (int c=0; c<K; c++){
+        x.push_back(centers[c][0]);
+        y.push_back(centers[c][1]);
+        size.push_back(20);
+        color.push_back(c);
+    }
+    auto l = scatter( x, y, size, color);
+    l->marker_style(line_spec::marker_style::cross);
+
+    show();
+}
+
+void KmeansClusterer::setSeeding(Seeding seeding_, unsigned seed_)
+{
+    seeding = seeding_;
+    seed    = seed_;
+}
+
+KmeansClusterer::Seeding KmeansClusterer::getSeeding() const
+{
+    return seeding;
+}
+
+void KmeansClusterer::setVerbose(bool verbose_)
+{
+    verbose = verbose_;
+}
+
+void KmeansClusterer::chooseSeedCenters(RowMajorMatrixXf& points)
+{
+    KmeansSeeder seeder(threadDatasets, verbose);
+    seeder.choose(seeding, seed, K, points);
+}
+
+void KmeansClusterer::setSeedCenters(const RowMajorMatrixXf& points)
+{
+    assert(points.rows() >= K);
+    seedCenters = points.topRows(K);
+}
+
+void KmeansClusterer::setInitialCenters()
+{
+    nanotimer timer;
+    timer.start();
+
+    RowMajorMatrixXf chosenPoints;
+    if (seedCenters.rows() > 0){
+        chosenPoints = seedCenters;
+    }else{
+        chooseSeedCenters(chosenPoints);
+    }
+
+    centers.resize(K);
+    for (int c=0; c<K; c++){
+        centers[c] = chosenPoints.row(c);
+    }
+
+    if (verbose){
+        cout << "seeding spent: " << timer.get_elapsed_ms() << " ms\n";
+    }
+}
+
+void KmeansClusterer::calculateClustersSums()
+{
+    clustersSums.setZero(K, vectorDimension);
+    clustersSizes.assign(K, 0);
+
+    // The clusters of the known points have the initial centers as their means, so their
+    // sums are the centers times the sizes, and the known points are not read.
+    for (PointIndex x=0; x<knownPointsNumber; x++){
+        clustersSizes[ assignments[x] ]++;
+    }
+    for (int c=0; c<K; c++){
+        clustersSums.row(c) = centers[c].cast<double>() * double(clustersSizes[c]);
+    }
+
+    // accumulate the other data points to the clusters, block by block. Each thread
+    // accumulates its points as changes in its state.
+    forEachThreadRange([&](int thread, PointIndex threadStartX, PointIndex threadEndX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        ThreadState& state = threadStates[thread];
+        const int blockLength = threadDataset.getBlockLength();
+        threadStartX = std::max(threadStartX, knownPointsNumber);
+        for (PointIndex startX=threadStartX; startX<threadEndX; startX+=blockLength){
+            PointIndex endX = std::min(startX + blockLength, threadEndX);
+            BlockView block = threadDataset.getBlock(startX, endX);
+            for (PointIndex x=startX; x<endX; x++){
+                int cx = assignments[x];
+                state.clustersSizes[cx]++;
+                state.clustersSums.row(cx) += block.row(x - startX).cast<double>();
+            }
+        }
+    });
+    reduceThreadStates();
+}
+
+void KmeansClusterer::moveAssignment(int thread, const PointView& point,
+                                          uint16_t from, uint16_t to)
+{
+    ThreadState& state = threadStates[thread];
+    Eigen::RowVectorXd p = point.cast<double>();
+    state.clustersSums.row(from) -= p;
+    state.clustersSums.row(to)   += p;
+    state.clustersSizes[from]--;
+    state.clustersSizes[to]++;
+}
+
+void KmeansClusterer::reduceThreadStates()
+{
+    assignmentChanged = false;
+    numberOfDistanceCalculation = 0;
+
+    // The states are added in the order of threads, so results do not depend on which
+    // thread finishes first.
+    for (ThreadState& state: threadStates){
+        assignmentChanged = assignmentChanged || state.assignmentChanged;
+        numberOfDistanceCalculation += state.numberOfDistanceCalculation;
+        clustersSums += state.clustersSums;
+        for (int c=0; c<K; c++){
+            clustersSizes[c] += state.clustersSizes[c];
+        }
+
+        state.numberOfDistanceCalculation = 0;
+        state.assignmentChanged = false;
+        state.clustersSums.setZero();
+        state.clustersSizes.assign(K, 0);
+    }
+}
+
+void KmeansClusterer::calculateNewCenters(vector<RowVectorXf>& newCenters)
+{
+    // dividing sums by cluster sizes to produce new centers. An empty cluster keeps its
+    // center.
+    newCenters.resize(K);
+    for (int c=0; c<K; c++){
+        if (clustersSizes[c] > 0){
+            newCenters[c] = (clustersSums.row(c) / double(clustersSizes[c])).cast<float>();
+        }else{
+            newCenters[c] = centers[c];
+        }
+    }
+}
+
+void KmeansClusterer::cluster()
+{
+    nanotimer timer;
+    timer.start();
+
+    if (verbose){
+        cout << "clustering " << N << " points into " << K << " clusters by "
+             << threadsNumber << " threads, bounds take "
+             << getBoundsMemory() / (1024 * 1024) << " MB\n";
+    }
+
+    // preparation.
+    // Randomly select some data points as initial centers.
+    setInitialCenters();
+    calculateInitialAssignment();
+    calculateClustersSums();
+
+    // iterations.
+    totalNumberOfDistanceCalculation = 0;
+    for (int iteration=0; ; iteration++){
+        if (verbose){
+            cout << "==== iteration #" << iteration << " ====\n";
+        }
+        runOneIteration();        
+        if (verbose){
+            cout << "numberOfDistanceCalculation = " << numberOfDistanceCalculation << "\n";
+        }
+        totalNumberOfDistanceCalculation += numberOfDistanceCalculation;
+        iterationsNumber = iteration + 1;
+        // The first iteration always runs, even if it changes no assignment: the initial
+        // assignment may be approximate, e.g. by the lower bounds of a matrix product, and
+        // the centers have not moved to the means of their clusters yet.
+        if (! assignmentChanged && iteration > 0) break;
+    }
+    //printStatus();
+    //draw();
+    if (verbose){
+        cout << "clustering converged.\n";
+        cout << "total number of distance calculation: " << totalNumberOfDistanceCalculation << "\n";
+
+        cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+    }
+}
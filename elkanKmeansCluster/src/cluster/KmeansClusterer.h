@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <stlHelper.h>
+#include "Dataset.h"
+
+using std::vector;
+using Eigen::RowVectorXf;
+using Eigen::MatrixXf;
+using Eigen::MatrixXd;
+
+// The common part of k-means engines which accelerate Lloyd's algorithm by bounds on
+// point-center distances. A sub-class keeps its own bounds, and implements the initial
+// assignment and the iterations; this class keeps the centers, the assignments and the sums
+// of clusters, and runs the iterations until no assignment changes.
+//
+// Points are processed by threadsNumber threads, each on a contiguous range of points and
+// reading its own cursor of the dataset. The assignment of a point depends only on the
+// centers, so results equal those of a single thread, up to the rounding of the sums of
+// clusters, which are kept in doubles.
+class KmeansClusterer {
+public:
+    KmeansClusterer(Dataset& dataset, int K_, int threadsNumber_);
+    virtual ~KmeansClusterer(){};
+
+    // how the initial centers are chosen.
+    //   UniformSeeding: K distinct data points, uniformly at random.
+    //   KmeansPlusPlusSeeding: k-means++. Each next center is a data point chosen with
+    //      probability proportional to its squared distance to the closest chosen center.
+    //   KmeansParallelSeeding: k-means||. In a few rounds, each point is chosen
+    //      independently with probability proportional to its squared distance, so that
+    //      about 2K points are chosen per round. The chosen points, weighted by the numbers
+    //      of points closest to them, are then clustered into K centers.
+    enum Seeding{ UniformSeeding, KmeansPlusPlusSeeding, KmeansParallelSeeding };
+
+    // The default is UniformSeeding with the default seed of the random engine.
+    void setSeeding(Seeding seeding, unsigned seed);
+    Seeding getSeeding() const;
+
+    // whether progress is printed. The default is true.
+    void setVerbose(bool verbose);
+
+    // choose K data points by the seeding method. For uniform and k-means++ seeding, the
+    // first k of them are also a seeding for k clusters, so they can seed smaller K.
+    void chooseSeedCenters(RowMajorMatrixXf& points);
+
+    // use the first K rows of the given points as the initial centers, instead of choosing
+    // them by the seeding method.
+    void setSeedCenters(const RowMajorMatrixXf& points);
+
+    void cluster();
+
+    const vector<RowVectorXf>& getCenters();
+    const vector<uint16_t>& getAssignments();
+    vector<PointIndex> getClusterSizes();
+
+    // statistics of the last clustering.
+    int getIterationsNumber();
+    long getTotalNumberOfDistanceCalculation();
+
+    // the sum of squared distances of all points to their centers.
+    double calculateInertia();
+
+    // bytes of memory taken by the bounds.
+    virtual long getBoundsMemory() = 0;
+
+    // debug functions.
+    void printStatus();
+
+    // Only applicable to two-dimensional data points.
+    void draw() const;
+
+protected:
+    // higher level functions.
+    // select K data points from the database by the seeding method, and set them as the
+    // initial centers.
+    void setInitialCenters();
+
+    // At the beginning, assign the data points to initial centers, and initialize the
+    // bounds.
+    virtual void calculateInitialAssignment() = 0;
+
+    // assign the data points to the closest centers, and move the centers to the means of
+    // their clusters, keeping the bounds valid.
+    virtual void runOneIteration() = 0;
+
+protected:
+    // middle level functions.
+    // calculate the sums and sizes of all clusters by a pass over all data points.
+    void calculateClustersSums();
+
+    // calculate new centers of the current iteration from the sums and sizes of clusters.
+    void calculateNewCenters(vector<RowVectorXf>& centersMeans);
+
+protected:
+    // lower level functions.
+    // the range of points processed by a thread. Ranges start at multiples of the block
+    // length of the dataset, so that blocks are not split between threads.
+    void getThreadRange(int thread, PointIndex& startX, PointIndex& endX);
+
+    // run function(thread, startX, endX) on all threads, each on its range of points.
+    template<typename Function>
+    void forEachThreadRange(Function function);
+
+    // move a data point from one cluster to another, recording the changes of the sums and
+    // sizes in the state of the thread.
+    void moveAssignment(int thread, const PointView& point, uint16_t from, uint16_t to);
+
+    // add the changes recorded by all threads to the sums and sizes of clusters, and clear
+    // the states of the threads.
+    void reduceThreadStates();
+
+    // calculate distance between all pairs of centers.
+    float pointToCenterDistance(const PointView& point, uint16_t center) const;
+    float centerToCenterDistance(uint16_t center1, uint16_t center2) const;
+    float centerToNewCenterDistance(uint16_t center, const RowVectorXf& newCenter) const;
+
+    // copy the centers into the rows of a matrix.
+    void getCentersMatrix(RowMajorMatrixXf& centersMatrix) const;
+
+    // calculate lower bounds of the distances from a block of points to all centers by one
+    // matrix product, expanding |x-c|^2 as |x|^2 - 2x.c + |c|^2. The expansion loses
+    // precision when a point is close to a center, so its rounding error is subtracted.
+    // Shape of distances is (points in the block, K).
+    void blockToCentersLowerDistances(const BlockView& block,
+                                      const RowMajorMatrixXf& centersMatrix,
+                                      RowMajorMatrixXf& distances) const;
+
+protected:
+    Dataset& dataset;
+    int vectorDimension;
+    PointIndex N;   // number of data points.
+    int K;   // cluster number.
+
+    // Shape is (N). For each point in x, keep which cluster it is assigned to. By using a
+    // short, we assume a limited number of clusters (fewer than 2^16).
+    vector<uint16_t> assignments;
+
+    // Shape is (K). k-th element is the center of the k-th cluster.
+    vector< RowVectorXf> centers;
+
+    // Shape is (K, vectorDimension). Sum of data points assigned to each cluster. They are
+    // updated only when assignments change, so new centers are calculated without a pass
+    // over all data points. Doubles are used, so that errors of the many additions and
+    // subtractions stay negligible.
+    MatrixXd clustersSums;
+
+    // Shape is (K). Number of data points assigned to each cluster.
+    vector<PointIndex> clustersSizes;
+
+    // whether there is any change of assignment. If so, the cluster has not converged.
+    bool assignmentChanged;
+
+    // debug. how many point-center calculations are performed, in the last iteration and
+    // in all iterations.
+    long numberOfDistanceCalculation;
+    long totalNumberOfDistanceCalculation;
+
+    int iterationsNumber;
+    bool verbose;
+
+    // seeding.
+    Seeding seeding;
+    unsigned seed;
+    RowMajorMatrixXf seedCenters;   // empty if not given.
+
+    // Number of the first data points whose assignments are given before clustering, e.g. by
+    // a previous clustering. Their clusters must have the initial centers as their means.
+    PointIndex knownPointsNumber;
+
+    // threads.
+    int threadsNumber;
+
+    // Shape is (threadsNumber). Datasets read by the threads. The first thread reads the
+    // dataset itself, other threads read their own cursors, which are owned by cursors.
+    vector<Dataset*> threadDatasets;
+    vector< std::unique_ptr<Dataset> > cursors;
+
+    // Threads share no writable states while assigning points. Each thread records its
+    // counters and the changes of clusters in its own state, and the states are added
+    // together after all threads finish.
+    struct ThreadState{
+        long numberOfDistanceCalculation;
+        bool assignmentChanged;
+        MatrixXd clustersSums;               // changes of clustersSums.
+        vector<PointIndex> clustersSizes;    // changes of clustersSizes.
+    };
+    vector<ThreadState> threadStates;
+};
+
+template<typename Function>
+void KmeansClusterer::forEachThreadRange(Function function)
+{
+    runInThreads(threadsNumber, [&](int thread){
+        PointIndex startX, endX;
+        getThreadRange(thread, startX, endX);
+        function(thread, startX, endX);
+    });
+}
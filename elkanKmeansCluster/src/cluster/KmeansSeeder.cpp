@@ -0,0 +1,285 @@
+#include <iostream>
+#include <cassert>
+#include <set>
+#include <limits>
+#include <algorithm>
+#include "KmeansSeeder.h"
+
+using namespace std;
+using namespace Eigen;
+
+KmeansSeeder::KmeansSeeder(const vector<Dataset*>& threadDatasets_, bool verbose_):
+    dataset(*threadDatasets_.front()), threadDatasets(threadDatasets_)
+{
+    vectorDimension = dataset.point(0).cols();
+    N = dataset.size();
+    verbose = verbose_;
+    threadsNumber = threadDatasets.size();
+}
+
+void KmeansSeeder::choose(KmeansClusterer::Seeding seeding, unsigned seed, int K,
+                          RowMajorMatrixXf& points)
+{
+    default_random_engine engine(seed);
+    if (seeding == KmeansClusterer::KmeansPlusPlusSeeding){
+        chooseKmeansPlusPlusCenters(engine, K, points);
+    }else if (seeding == KmeansClusterer::KmeansParallelSeeding){
+        chooseKmeansParallelCenters(engine, seed, K, points);
+    }else{
+        chooseUniformCenters(engine, K, points);
+    }
+}
+
+void KmeansSeeder::chooseUniformCenters(default_random_engine& engine, int K,
+                                        RowMajorMatrixXf& points)
+{
+    uniform_int_distribution<PointIndex> uniformDist(0, N - 1);
+    set<PointIndex> chosenIndexes;
+    vector<PointIndex> centerIndexes;
+
+    for (int c=0; c<K; c++){
+        // get a random but unseen index.
+        PointIndex randomPointIndex;
+        do{
+            randomPointIndex = uniformDist(engine);
+        }while ( chosenIndexes.count(randomPointIndex)>0 );
+
+        chosenIndexes.insert(randomPointIndex);
+        centerIndexes.push_back(randomPointIndex);
+    }
+
+    // The points are scattered over the dataset, so they are gathered at once, which
+    // reads only the chosen points.
+    dataset.gather(centerIndexes, points);
+}
+
+double KmeansSeeder::updateClosestDistances(const RowMajorMatrixXf& newCenters,
+                                            vector<float>& closestDistances)
+{
+    vector<double> threadSums(threadsNumber, 0.0);
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        double sum = 0.0;
+        for (PointIndex x=startX; x<endX; x++){
+            PointView point = threadDataset.point(x);
+            for (int c=0; c<newCenters.rows(); c++){
+                float distance = (point - newCenters.row(c)).squaredNorm();
+                closestDistances[x] = std::min(closestDistances[x], distance);
+            }
+            sum += closestDistances[x];
+        }
+        threadSums[thread] = sum;
+    });
+
+    double sum = 0.0;
+    for (double threadSum: threadSums){
+        sum += threadSum;
+    }
+    return sum;
+}
+
+// return the first index whose cumulative weight exceeds target. Weights are summed in
+// doubles.
+template<typename Weights>
+static PointIndex sampleByWeights(const Weights& weights, PointIndex size, double target)
+{
+    double cumulativeWeight = 0.0;
+    for (PointIndex x=0; x<size; x++){
+        cumulativeWeight += weights[x];
+        if (cumulativeWeight > target){
+            return x;
+        }
+    }
+    // rounding may leave the target slightly beyond the sum.
+    for (PointIndex x=size-1; x>0; x--){
+        if (weights[x] > 0){
+            return x;
+        }
+    }
+    return 0;
+}
+
+// return a uniformly random index in [0, size) which is not chosen yet. Used when all
+// remaining weights are zero, e.g. when there are fewer distinct points than centers.
+static PointIndex sampleUnchosen(default_random_engine& engine, PointIndex size,
+                                 const set<PointIndex>& chosenIndexes)
+{
+    uniform_int_distribution<PointIndex> uniformDist(0, size - 1);
+    PointIndex x;
+    do{
+        x = uniformDist(engine);
+    }while ( chosenIndexes.count(x)>0 );
+    return x;
+}
+
+void KmeansSeeder::chooseKmeansPlusPlusCenters(default_random_engine& engine, int K,
+                                               RowMajorMatrixXf& points)
+{
+    // the first center is uniformly random.
+    uniform_int_distribution<PointIndex> uniformDist(0, N - 1);
+    vector<PointIndex> centerIndexes = { uniformDist(engine) };
+    set<PointIndex> chosenIndexes(centerIndexes.begin(), centerIndexes.end());
+    dataset.gather(centerIndexes, points);
+
+    // Each of the following centers is chosen with probability proportional to the squared
+    // distance to the closest chosen center, which is updated by a pass over all points.
+    vector<float> closestDistances(N, numeric_limits<float>::max());
+    uniform_real_distribution<double> uniformReal(0.0, 1.0);
+    for (int c=1; c<K; c++){
+        double sum = updateClosestDistances(points.bottomRows(1), closestDistances);
+        PointIndex chosen = (sum > 0.0) ?
+                            sampleByWeights(closestDistances, N, uniformReal(engine) * sum) :
+                            sampleUnchosen(engine, N, chosenIndexes);
+        centerIndexes.push_back(chosen);
+        chosenIndexes.insert(chosen);
+
+        points.conservativeResize(c + 1, Eigen::NoChange);
+        points.row(c) = dataset.point(chosen);
+    }
+}
+
+// splitmix64.
+static uint64_t splitmix64(uint64_t z)
+{
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// A random number in [0, 1) determined by the seed, the round and the point, so that the
+// points chosen by k-means|| do not depend on how points are split between threads. Each
+// component is mixed in by its own splitmix64 step, so no bits of them overlap.
+static double hashToUniform(unsigned seed, int round, PointIndex x)
+{
+    uint64_t z = splitmix64(seed);
+    z = splitmix64(z ^ uint64_t(round));
+    z = splitmix64(z ^ uint64_t(x));
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void KmeansSeeder::chooseKmeansParallelCenters(default_random_engine& engine, unsigned seed,
+                                               int K, RowMajorMatrixXf& points)
+{
+    const int rounds = 5;
+    const double oversampling = 2.0 * K;
+
+    // candidates. The first one is uniformly random.
+    uniform_int_distribution<PointIndex> uniformDist(0, N - 1);
+    vector<PointIndex> candidateIndexes = { uniformDist(engine) };
+    RowMajorMatrixXf candidates;
+    dataset.gather(candidateIndexes, candidates);
+
+    // In each round, every point is chosen independently with probability
+    // oversampling * d^2 / sum(d^2). Points are chosen by the threads in their ranges, and
+    // gathered in the order of points.
+    vector<float> closestDistances(N, numeric_limits<float>::max());
+    RowMajorMatrixXf newCandidates = candidates;
+    for (int round=0; round<rounds; round++){
+        double sum = updateClosestDistances(newCandidates, closestDistances);
+        if (sum <= 0.0){
+            break;
+        }
+
+        vector< vector<PointIndex> > threadChosen(threadsNumber);
+        forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+            for (PointIndex x=startX; x<endX; x++){
+                if (hashToUniform(seed, round, x) < oversampling * closestDistances[x] / sum){
+                    threadChosen[thread].push_back(x);
+                }
+            }
+        });
+        vector<PointIndex> chosenIndexes;
+        for (vector<PointIndex>& chosen: threadChosen){
+            chosenIndexes.insert(chosenIndexes.end(), chosen.begin(), chosen.end());
+        }
+        if (chosenIndexes.empty()){
+            continue;
+        }
+
+        dataset.gather(chosenIndexes, newCandidates);
+        candidateIndexes.insert(candidateIndexes.end(), chosenIndexes.begin(), chosenIndexes.end());
+        candidates.conservativeResize(candidates.rows() + newCandidates.rows(), Eigen::NoChange);
+        candidates.bottomRows(newCandidates.rows()) = newCandidates;
+    }
+    if (verbose){
+        cout << "k-means|| chose " << candidates.rows() << " candidates\n";
+    }
+
+    // With too few candidates, e.g. for a tiny dataset, fall back to uniform seeding.
+    if (candidates.rows() < K){
+        chooseUniformCenters(engine, K, points);
+        return;
+    }
+
+    // weight each candidate by the number of points closest to it.
+    const int M = candidates.rows();
+    vector< vector<double> > threadWeights(threadsNumber, vector<double>(M, 0.0));
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        for (PointIndex x=startX; x<endX; x++){
+            PointView point = threadDataset.point(x);
+            Eigen::Index closest;
+            (candidates.rowwise() - point).rowwise().squaredNorm().minCoeff(&closest);
+            threadWeights[thread][closest] += 1.0;
+        }
+    });
+    vector<double> weights(M, 0.0);
+    for (vector<double>& threadWeight: threadWeights){
+        for (int m=0; m<M; m++){
+            weights[m] += threadWeight[m];
+        }
+    }
+
+    // recluster the weighted candidates in memory: weighted k-means++, then Lloyd's
+    // iterations.
+    uniform_real_distribution<double> uniformReal(0.0, 1.0);
+    vector<float> candidateDistances(M, numeric_limits<float>::max());
+    vector<double> weightedDistances(M);
+    vector<int> chosen = { int(sampleByWeights(weights, M, uniformReal(engine) * N)) };
+    set<PointIndex> chosenCandidates = { chosen.back() };
+    for (int c=1; c<K; c++){
+        double sum = 0.0;
+        for (int m=0; m<M; m++){
+            float distance = (candidates.row(m) - candidates.row(chosen.back())).squaredNorm();
+            candidateDistances[m] = std::min(candidateDistances[m], distance);
+            weightedDistances[m] = weights[m] * candidateDistances[m];
+            sum += weightedDistances[m];
+        }
+        chosen.push_back( (sum > 0.0) ?
+                          sampleByWeights(weightedDistances, M, uniformReal(engine) * sum) :
+                          sampleUnchosen(engine, M, chosenCandidates) );
+        chosenCandidates.insert(chosen.back());
+    }
+
+    points.resize(K, vectorDimension);
+    for (int c=0; c<K; c++){
+        points.row(c) = candidates.row(chosen[c]);
+    }
+    vector<int> candidateAssignments(M, -1);
+    for (int iteration=0; iteration<20; iteration++){
+        bool changed = false;
+        for (int m=0; m<M; m++){
+            Eigen::Index closest;
+            (points.rowwise() - candidates.row(m)).rowwise().squaredNorm().minCoeff(&closest);
+            changed = changed || closest != candidateAssignments[m];
+            candidateAssignments[m] = closest;
+        }
+        if ( !changed ){
+            break;
+        }
+
+        // an empty cluster keeps its center.
+        MatrixXd sums = MatrixXd::Zero(K, vectorDimension);
+        vector<double> sizes(K, 0.0);
+        for (int m=0; m<M; m++){
+            sums.row(candidateAssignments[m]) += weights[m] * candidates.row(m).cast<double>();
+            sizes[candidateAssignments[m]] += weights[m];
+        }
+        for (int c=0; c<K; c++){
+            if (sizes[c] > 0){
+                points.row(c) = (sums.row(c) / sizes[c]).cast<float>();
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <stlHelper.h>
+#include "Dataset.h"
+#include "KmeansClusterer.h"
+
+using std::vector;
+
+// The seeding methods of KmeansClusterer, choosing initial centers among the points of a
+// dataset. The seeder keeps no state of its own besides the datasets, so it can be used by
+// any engine, including those keeping no per-point state.
+//
+// Uniform seeding draws K distinct indexes and gathers the points, so its memory does not
+// grow with the dataset. k-means++ and k-means|| keep the squared distance of every point to
+// the closest chosen center, i.e. N floats, and make passes over all points, each thread on
+// a contiguous range of points and reading its own dataset.
+class KmeansSeeder {
+public:
+    // threadDatasets are read by the threads. The first one is the dataset itself, the
+    // others are its cursors. They must outlive the seeder.
+    KmeansSeeder(const vector<Dataset*>& threadDatasets, bool verbose);
+
+    // choose K data points by the seeding method. For uniform and k-means++ seeding, the
+    // first k of them are also a seeding for k clusters, so they can seed smaller K.
+    void choose(KmeansClusterer::Seeding seeding, unsigned seed, int K,
+                RowMajorMatrixXf& points);
+
+private:
+    // seeding methods. Each returns the chosen points.
+    void chooseUniformCenters(std::default_random_engine& engine, int K,
+                              RowMajorMatrixXf& points);
+    void chooseKmeansPlusPlusCenters(std::default_random_engine& engine, int K,
+                                     RowMajorMatrixXf& points);
+    void chooseKmeansParallelCenters(std::default_random_engine& engine, unsigned seed, int K,
+                                     RowMajorMatrixXf& points);
+
+    // For each data point, lower its squared distance to the closest chosen center to the
+    // distances to the given new centers. Return the sum of the squared distances.
+    double updateClosestDistances(const RowMajorMatrixXf& newCenters,
+                                  vector<float>& closestDistances);
+
+    // run function(thread, startX, endX) on all threads, each on its range of points, as
+    // KmeansClusterer::forEachThreadRange().
+    template<typename Function>
+    void forEachThreadRange(Function function);
+
+private:
+    Dataset& dataset;
+    int vectorDimension;
+    PointIndex N;   // number of data points.
+    bool verbose;
+
+    int threadsNumber;
+    vector<Dataset*> threadDatasets;
+};
+
+template<typename Function>
+void KmeansSeeder::forEachThreadRange(Function function)
+{
+    const int blockLength = dataset.getBlockLength();
+    const PointIndex blocksNumber = (N + blockLength - 1) / blockLength;
+    runInThreads(threadsNumber, [&](int thread){
+        PointIndex startX = std::min(N, blocksNumber * thread / threadsNumber * blockLength);
+        PointIndex endX   = std::min(N, blocksNumber * (thread + 1) / threadsNumber * blockLength);
+        function(thread, startX, endX);
+    });
+}
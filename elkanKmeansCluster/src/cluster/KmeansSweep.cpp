@@ -0,0 +1,94 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <nanotimer.h>
+#include "KmeansSweep.h"
+
+using namespace std;
+
+KmeansSweep::KmeansSweep(Dataset& dataset, const vector<int>& Ks_, int threadsNumber_,
+                         ClustererFactory createClusterer_)
+{
+    Ks = Ks_;
+    sort(Ks.begin(), Ks.end(), greater<int>());
+    Ks.erase( unique(Ks.begin(), Ks.end()), Ks.end() );
+
+    threadsNumber   = std::max(1, std::min<int>(threadsNumber_, Ks.size()));
+    createClusterer = createClusterer_;
+
+    // spare threads are shared by the runs.
+    threadsPerRun = std::max(1, threadsNumber_ / threadsNumber);
+
+    threadDatasets.push_back(&dataset);
+    for (int thread=1; thread<threadsNumber; thread++){
+        cursors.push_back( dataset.createCursor() );
+        threadDatasets.push_back( cursors.back().get() );
+    }
+}
+
+void KmeansSweep::cluster()
+{
+    nanotimer timer;
+    timer.start();
+
+    // seed the largest K, before other runs start, unless each run seeds its own K.
+    unique_ptr<KmeansClusterer> largestClusterer = createClusterer(*threadDatasets[0], Ks[0],
+                                                                   threadsPerRun);
+    largestClusterer->setVerbose(false);
+    const bool sharedSeeding =
+        largestClusterer->getSeeding() != KmeansClusterer::KmeansParallelSeeding;
+    RowMajorMatrixXf seedCenters;
+    if (sharedSeeding){
+        largestClusterer->chooseSeedCenters(seedCenters);
+        cout << "seeding " << Ks[0] << " centers spent: " << timer.get_elapsed_ms() << " ms\n";
+    }
+
+    results.assign(Ks.size(), SweepResult());
+    runInThreads(threadsNumber, [&](int thread){
+        for (int run=thread; run<int(Ks.size()); run+=threadsNumber){
+            unique_ptr<KmeansClusterer> clusterer;
+            if (run == 0){
+                clusterer = std::move(largestClusterer);
+            }else{
+                clusterer = createClusterer(*threadDatasets[thread], Ks[run], threadsPerRun);
+                clusterer->setVerbose(false);
+            }
+            if (sharedSeeding){
+                clusterer->setSeedCenters(seedCenters);
+            }
+            clusterer->cluster();
+
+            SweepResult& result = results[run];
+            result.K = Ks[run];
+            result.inertia = clusterer->calculateInertia();
+            result.iterationsNumber = clusterer->getIterationsNumber();
+            result.numberOfDistanceCalculation = clusterer->getTotalNumberOfDistanceCalculation();
+        }
+    });
+
+    // print in increasing K.
+    for (int run=Ks.size()-1; run>=0; run--){
+        const SweepResult& result = results[run];
+        cout << "K " << result.K << ": inertia " << result.inertia
+             << ", iterations " << result.iterationsNumber
+             << ", distance calculations " << result.numberOfDistanceCalculation << "\n";
+    }
+    cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+}
+
+void KmeansSweep::writeTable(const string& filename)
+{
+    ofstream file(filename);
+    if ( !file ){
+        throw runtime_error("cannot open " + filename);
+    }
+
+    file.precision(12);
+    file << "K\tinertia\titerations\tdistanceCalculations\n";
+    for (int run=Ks.size()-1; run>=0; run--){
+        const SweepResult& result = results[run];
+        file << result.K << "\t" << result.inertia << "\t" << result.iterationsNumber
+             << "\t" << result.numberOfDistanceCalculation << "\n";
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "KmeansClusterer.h"
+
+// Cluster the same dataset into several numbers of clusters, to help choosing K. The runs
+// share one loaded dataset, and run concurrently on threadsNumber threads, each thread
+// reading its own cursor of the dataset. If there are more threads than runs, each run gets
+// several threads.
+//
+// For uniform and k-means++ seeding, seeding is done once, for the largest K, and the run of
+// each smaller K starts from the first K of these centers. The centers chosen by k-means|| for
+// the largest K are no seeding for smaller K, so with k-means|| each run seeds its own K. A
+// clusterer is created by a factory from the dataset it should read, its K and the number of
+// threads it may use.
+class KmeansSweep {
+public:
+    typedef std::function< std::unique_ptr<KmeansClusterer>(Dataset& dataset, int K,
+                                                            int threadsNumber) > ClustererFactory;
+
+    KmeansSweep(Dataset& dataset, const vector<int>& Ks, int threadsNumber,
+                ClustererFactory createClusterer);
+
+    // run all K, and print the table of inertia versus K.
+    void cluster();
+
+    // write the table of inertia versus K as text, one K per line.
+    void writeTable(const std::string& filename);
+
+private:
+    struct SweepResult{
+        int K;
+        double inertia;
+        int iterationsNumber;
+        long numberOfDistanceCalculation;
+    };
+
+    // Shape is (number of K). Sorted in decreasing order, so the largest K, whose clusterer
+    // chooses the shared seed centers, runs first on the first thread.
+    vector<int> Ks;
+    int threadsNumber;   // runs of K running concurrently.
+    int threadsPerRun;
+    ClustererFactory createClusterer;
+
+    // Shape is (threadsNumber). Datasets read by the threads, as in KmeansClusterer.
+    vector<Dataset*> threadDatasets;
+    vector< std::unique_ptr<Dataset> > cursors;
+
+    // Shape is (number of K).
+    vector<SweepResult> results;
+};
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <algorithm>
+#include <set>
+#include <nanotimer.h>
+#include <stlHelper.h>
+#include "MiniBatchKmeansClusterer.h"
+#include "KmeansSeeder.h"
+#include "SubsetDataset.h"
+#include "DenseDataset.h"
+
+using namespace std;
+using namespace Eigen;
+
+MiniBatchKmeansClusterer::MiniBatchKmeansClusterer(Dataset& dataset_, int K_, int threadsNumber_,
+                                                   int blocksPerBatch_, float tolerance_,
+                                                   int maxBatches_):
+    dataset(dataset_)
+{
+    vectorDimension = dataset.point(0).cols();
+    N = dataset.size();
+    K = K_;
+    threadsNumber  = std::max(1, threadsNumber_);
+    blocksPerBatch = std::max(1, blocksPerBatch_);
+    tolerance      = tolerance_;
+    maxBatches     = maxBatches_;
+
+    seeding = KmeansClusterer::UniformSeeding;
+    seed    = default_random_engine::default_seed;
+    batchSize = 0;
+
+    centersCounts.assign(K, 0);
+    numberOfDistanceCalculation = 0;
+}
+
+void MiniBatchKmeansClusterer::setSeeding(KmeansClusterer::Seeding seeding_, unsigned seed_)
+{
+    seeding = seeding_;
+    seed    = seed_;
+    engine.seed(seed);
+}
+
+const vector<RowVectorXf>& MiniBatchKmeansClusterer::getCenters()
+{
+    return centers;
+}
+
+const vector<int64_t>& MiniBatchKmeansClusterer::getCentersCounts()
+{
+    return centersCounts;
+}
+
+void MiniBatchKmeansClusterer::setInitialCenters()
+{
+    RowMajorMatrixXf chosenPoints;
+    if (seeding == KmeansClusterer::UniformSeeding){
+        // only the chosen points are read.
+        KmeansSeeder seeder({ &dataset }, true);
+        seeder.choose(seeding, seed, K, chosenPoints);
+    }else{
+        // The other seedings keep a distance per point and make passes over all points, so
+        // they choose from a sample of randomly chosen blocks, loaded into memory.
+        const int blockLength = dataset.getBlockLength();
+        PointIndex blocksNumber = (N + blockLength - 1) / blockLength;
+        PointIndex sampleBlocksNumber = std::max<PointIndex>(blocksPerBatch,
+            (seedingPointsPerCenter * K + blockLength - 1) / blockLength);
+        sampleBlocksNumber = std::min(sampleBlocksNumber, blocksNumber);
+
+        set<PointIndex> sampleBlocks;
+        uniform_int_distribution<PointIndex> uniformDist(0, blocksNumber - 1);
+        while ( PointIndex(sampleBlocks.size()) < sampleBlocksNumber ){
+            sampleBlocks.insert( uniformDist(engine) );
+        }
+        shared_ptr< vector<PointIndex> > sampleIndexes = make_shared< vector<PointIndex> >();
+        for (PointIndex block: sampleBlocks){
+            PointIndex endX = std::min((block + 1) * blockLength, N);
+            for (PointIndex x=block*blockLength; x<endX; x++){
+                sampleIndexes->push_back(x);
+            }
+        }
+
+        SubsetDataset subset(dataset, sampleIndexes);
+        DenseDataset sample(subset);
+        vector< unique_ptr<Dataset> > cursors;
+        vector<Dataset*> threadDatasets = { &sample };
+        for (int thread=1; thread<threadsNumber; thread++){
+            cursors.push_back( sample.createCursor() );
+            threadDatasets.push_back( cursors.back().get() );
+        }
+        KmeansSeeder seeder(threadDatasets, true);
+        seeder.choose(seeding, seed, K, chosenPoints);
+    }
+    centers.resize(K);
+    for (int c=0; c<K; c++){
+        centers[c] = chosenPoints.row(c);
+    }
+}
+
+void MiniBatchKmeansClusterer::readBatch()
+{
+    // Blocks are read whole, so that a dataset reading segments reads each chosen segment
+    // once.
+    const int blockLength = dataset.getBlockLength();
+    PointIndex blocksNumber = (N + blockLength - 1) / blockLength;
+    uniform_int_distribution<PointIndex> uniformDist(0, blocksNumber - 1);
+
+    if (batch.rows() != PointIndex(blocksPerBatch) * blockLength){
+        batch.resize(PointIndex(blocksPerBatch) * blockLength, vectorDimension);
+    }
+    // the last block of the dataset may be shorter.
+    batchSize = 0;
+    for (int b=0; b<blocksPerBatch; b++){
+        PointIndex startX = uniformDist(engine) * blockLength;
+        PointIndex endX   = std::min(startX + blockLength, N);
+        BlockView block = dataset.getBlock(startX, endX);
+        batch.middleRows(batchSize, block.rows()) = block;
+        batchSize += block.rows();
+    }
+}
+
+double MiniBatchKmeansClusterer::assignBatch()
+{
+    batchAssignments.resize(batchSize);
+    vector<double> threadInertias(threadsNumber, 0.0);
+    runInThreads(threadsNumber, [&](int thread){
+        PointIndex startX = batchSize * thread / threadsNumber;
+        PointIndex endX   = batchSize * (thread + 1) / threadsNumber;
+        for (PointIndex x=startX; x<endX; x++){
+            uint16_t closest = 0;
+            float minDistance = numeric_limits<float>::max();
+            for (int c=0; c<K; c++){
+                float distance = (batch.row(x) - centers[c]).squaredNorm();
+                if (distance < minDistance){
+                    minDistance = distance;
+                    closest = c;
+                }
+            }
+            batchAssignments[x] = closest;
+            threadInertias[thread] += minDistance;
+        }
+    });
+    numberOfDistanceCalculation += batchSize * K;
+
+    double inertia = 0.0;
+    for (double threadInertia: threadInertias){
+        inertia += threadInertia;
+    }
+    return inertia / batchSize;
+}
+
+void MiniBatchKmeansClusterer::updateCenters()
+{
+    for (PointIndex x=0; x<batchSize; x++){
+        uint16_t c = batchAssignments[x];
+        centersCounts[c]++;
+        float learningRate = 1.0f / centersCounts[c];
+        centers[c] += learningRate * (batch.row(x) - centers[c]);
+    }
+}
+
+void MiniBatchKmeansClusterer::cluster()
+{
+    nanotimer timer;
+    timer.start();
+
+    setInitialCenters();
+
+    // The inertia of a batch is noisy, so it is smoothed over about smoothingBatches
+    // batches before being compared with its lowest value.
+    const int smoothingBatches = 10;
+    const double smoothingFactor = 2.0 / (smoothingBatches + 1);
+    const int maxBatchesWithoutImprovement = 10;
+    double smoothedInertia = 0.0;
+    double lowestSmoothedInertia = numeric_limits<double>::max();
+    int batchesWithoutImprovement = 0;
+
+    int batchIndex;
+    for (batchIndex=0; batchIndex<maxBatches; batchIndex++){
+        readBatch();
+        double batchInertia = assignBatch();
+        updateCenters();
+
+        smoothedInertia = (batchIndex == 0) ? batchInertia :
+                          smoothedInertia + smoothingFactor * (batchInertia - smoothedInertia);
+        cout << "==== batch #" << batchIndex << " ==== " << batchSize
+             << " points, inertia per point = " << batchInertia
+             << ", smoothed = " << smoothedInertia << "\n";
+        if (smoothedInertia < lowestSmoothedInertia * (1.0 - tolerance)){
+            lowestSmoothedInertia = smoothedInertia;
+            batchesWithoutImprovement = 0;
+        }else if (++batchesWithoutImprovement >= maxBatchesWithoutImprovement){
+            break;
+        }
+    }
+
+    if (batchIndex < maxBatches){
+        cout << "clustering stopped after " << batchIndex + 1 << " batches, as the smoothed "
+             << "inertia did not decrease for " << maxBatchesWithoutImprovement << " batches.\n";
+    }else{
+        cout << "clustering stopped after " << maxBatches << " batches.\n";
+    }
+    cout << "total number of distance calculation: " << numberOfDistanceCalculation << "\n";
+    cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+}
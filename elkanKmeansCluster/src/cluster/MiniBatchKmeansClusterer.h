@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <random>
+#include "Dataset.h"
+#include "KmeansClusterer.h"
+
+using std::vector;
+using Eigen::RowVectorXf;
+
+// Mini-batch k-means. Each iteration reads a batch of randomly chosen blocks of the dataset,
+// e.g. segments of a feature file, assigns the points of the batch to the closest centers,
+// and moves each center towards its points with a learning rate of 1/(number of points it
+// has been assigned so far). Only the batch is kept in memory, so memory does not grow with
+// the size of the dataset, and no assignment of all points is produced.
+//
+// The learning rate decays as centers gain points, so their movement shrinks whether or not
+// they are good. Instead, clustering stops when the inertia of the batches, the mean squared
+// distance of their points to the closest centers smoothed exponentially over about 10
+// batches, has not decreased by more than tolerance times its lowest value for 10 batches,
+// or after maxBatches batches.
+class MiniBatchKmeansClusterer {
+public:
+    MiniBatchKmeansClusterer(Dataset& dataset, int K, int threadsNumber,
+                             int blocksPerBatch, float tolerance, int maxBatches);
+
+    // how the initial centers are chosen, as KmeansClusterer::setSeeding(), and the seed of
+    // the random engine choosing them and the batches. Uniform seeding reads only the chosen
+    // points. k-means++ and k-means|| choose from a sample of randomly chosen blocks, of at
+    // least a batch and seedingPointsPerCenter points per center, which is loaded into
+    // memory, so their memory grows with K but not with the size of the dataset.
+    void setSeeding(KmeansClusterer::Seeding seeding, unsigned seed);
+
+    void cluster();
+
+    const vector<RowVectorXf>& getCenters();
+
+    // Shape is (K). Number of points assigned to each center over all batches.
+    const vector<int64_t>& getCentersCounts();
+
+private:
+    static const int seedingPointsPerCenter = 100;
+
+    // select K data points by the seeding method and set them as the initial centers.
+    void setInitialCenters();
+
+    // read randomly chosen blocks into the batch.
+    void readBatch();
+
+    // assign each point of the batch to the closest center, on all threads. Return the
+    // mean squared distance of the points to their centers.
+    double assignBatch();
+
+    // move the centers towards the points of the batch.
+    void updateCenters();
+
+private:
+    Dataset& dataset;
+    int vectorDimension;
+    PointIndex N;   // number of data points.
+    int K;   // cluster number.
+    int threadsNumber;
+
+    int   blocksPerBatch;
+    float tolerance;
+    int   maxBatches;
+
+    KmeansClusterer::Seeding seeding;
+    unsigned seed;
+    std::default_random_engine engine;
+
+    // Shape is (K). k-th element is the center of the k-th cluster.
+    vector<RowVectorXf> centers;
+
+    // Shape is (K).
+    vector<int64_t> centersCounts;
+
+    // points of the current batch, one per row, and their assignments. The batch is
+    // allocated for blocksPerBatch whole blocks, and its first batchSize rows are used.
+    RowMajorMatrixXf batch;
+    PointIndex batchSize;
+    vector<uint16_t> batchAssignments;
+
+    // debug. how many point-center calculations are performed.
+    long numberOfDistanceCalculation;
+};
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <nanotimer.h>
+#include "MultiRestartKmeans.h"
+
+using namespace std;
+
+MultiRestartKmeans::MultiRestartKmeans(Dataset& dataset, int restartsNumber_,
+                                       int threadsNumber_, ClustererFactory createClusterer_)
+{
+    restartsNumber  = std::max(1, restartsNumber_);
+    threadsNumber   = std::max(1, std::min(threadsNumber_, restartsNumber));
+    createClusterer = createClusterer_;
+
+    // spare threads are shared by the restarts.
+    threadsPerRestart = std::max(1, threadsNumber_ / threadsNumber);
+
+    threadDatasets.push_back(&dataset);
+    for (int thread=1; thread<threadsNumber; thread++){
+        cursors.push_back( dataset.createCursor() );
+        threadDatasets.push_back( cursors.back().get() );
+    }
+
+    bestRestart = -1;
+}
+
+void MultiRestartKmeans::cluster(unsigned seed)
+{
+    nanotimer timer;
+    timer.start();
+
+    results.assign(restartsNumber, RestartResult());
+    bestRestart = -1;
+    bestClusterer.reset();
+
+    mutex bestMutex;
+    runInThreads(threadsNumber, [&](int thread){
+        for (int restart=thread; restart<restartsNumber; restart+=threadsNumber){
+            RestartResult& result = results[restart];
+            result.seed = seed + restart;
+
+            unique_ptr<KmeansClusterer> clusterer = createClusterer(*threadDatasets[thread],
+                                                                    threadsPerRestart,
+                                                                    result.seed);
+            clusterer->setVerbose(false);
+            clusterer->cluster();
+
+            result.inertia = clusterer->calculateInertia();
+            result.iterationsNumber = clusterer->getIterationsNumber();
+            result.numberOfDistanceCalculation = clusterer->getTotalNumberOfDistanceCalculation();
+
+            // Ties are broken by the restart index, so the result does not depend on the
+            // order in which threads finish.
+            lock_guard<mutex> lock(bestMutex);
+            if (bestRestart < 0 || result.inertia < results[bestRestart].inertia ||
+                (result.inertia == results[bestRestart].inertia && restart < bestRestart)){
+                bestRestart = restart;
+                bestClusterer = std::move(clusterer);
+            }
+        }
+    });
+
+    printStatistics();
+    cout << "total clustering spent: " << timer.get_elapsed_ms() << " ms\n";
+}
+
+KmeansClusterer& MultiRestartKmeans::getBestClusterer()
+{
+    return *bestClusterer;
+}
+
+void MultiRestartKmeans::printStatistics()
+{
+    for (int restart=0; restart<int(results.size()); restart++){
+        const RestartResult& result = results[restart];
+        cout << "restart #" << restart << ": seed " << result.seed
+             << ", inertia " << result.inertia
+             << ", iterations " << result.iterationsNumber
+             << ", distance calculations " << result.numberOfDistanceCalculation << "\n";
+    }
+    cout << "the best is restart #" << bestRestart << "\n";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KmeansClusterer.h"
+
+// Run k-means several times from different seeds, and keep the result with the lowest
+// inertia. Restarts run concurrently on threadsNumber threads, each thread reading its own
+// cursor of the dataset, so the points are read or loaded only once for all restarts. If
+// there are more threads than restarts, each restart gets several threads.
+//
+// A restart is clustered by the clusterer created by a factory, from the dataset it should
+// read, the number of threads it may use and its seed. Restart r uses seed + r. Only the
+// best clusterer is kept, so memory of bounds is taken by at most threadsNumber running
+// clusterers and the best one.
+class MultiRestartKmeans {
+public:
+    typedef std::function< std::unique_ptr<KmeansClusterer>(Dataset& dataset,
+                                                            int threadsNumber,
+                                                            unsigned seed) > ClustererFactory;
+
+    MultiRestartKmeans(Dataset& dataset, int restartsNumber, int threadsNumber,
+                       ClustererFactory createClusterer);
+
+    // run all restarts, and print the statistics of each.
+    void cluster(unsigned seed);
+
+    // the clusterer of the restart with the lowest inertia.
+    KmeansClusterer& getBestClusterer();
+
+    void printStatistics();
+
+private:
+    struct RestartResult{
+        unsigned seed;
+        double inertia;
+        int iterationsNumber;
+        long numberOfDistanceCalculation;
+    };
+
+    int restartsNumber;
+    int threadsNumber;   // restarts running concurrently.
+    int threadsPerRestart;
+    ClustererFactory createClusterer;
+
+    // Shape is (threadsNumber). Datasets read by the threads, as in KmeansClusterer.
+    vector<Dataset*> threadDatasets;
+    vector< std::unique_ptr<Dataset> > cursors;
+
+    // Shape is (restartsNumber).
+    vector<RestartResult> results;
+
+    int bestRestart;
+    std::unique_ptr<KmeansClusterer> bestClusterer;
+};
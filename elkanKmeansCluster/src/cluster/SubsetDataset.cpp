@@ -0,0 +1,51 @@
+#include <cassert>
+#include "SubsetDataset.h"
+
+using namespace std;
+
+SubsetDataset::SubsetDataset(Dataset& source_, shared_ptr<const vector<PointIndex>> pointIndexes_):
+    source(&source_), pointIndexes(pointIndexes_)
+{
+    setSize(pointIndexes->size());
+}
+
+SubsetDataset::SubsetDataset(unique_ptr<Dataset> sourceCursor_,
+                             shared_ptr<const vector<PointIndex>> pointIndexes_):
+    sourceCursor(std::move(sourceCursor_)), pointIndexes(pointIndexes_)
+{
+    source = sourceCursor.get();
+    setSize(pointIndexes->size());
+}
+
+unique_ptr<Dataset> SubsetDataset::createCursor()
+{
+    return unique_ptr<Dataset>( new SubsetDataset(source->createCursor(), pointIndexes) );
+}
+
+PointView SubsetDataset::point(PointIndex pointIndex)
+{
+    assert( pointIndex < size() );
+    return source->point( (*pointIndexes)[pointIndex] );
+}
+
+BlockView SubsetDataset::getBlock(PointIndex startX, PointIndex endX)
+{
+    assert( startX < endX && endX <= size() );
+    blockIndexes.assign(pointIndexes->begin() + startX, pointIndexes->begin() + endX);
+    source->gather(blockIndexes, blockPoints);
+    return BlockView(blockPoints.data(), blockPoints.rows(), blockPoints.cols());
+}
+
+void SubsetDataset::gather(const vector<PointIndex>& indexes, RowMajorMatrixXf& points)
+{
+    vector<PointIndex> sourceIndexes(indexes.size());
+    for (size_t i=0; i<indexes.size(); i++){
+        sourceIndexes[i] = (*pointIndexes)[ indexes[i] ];
+    }
+    source->gather(sourceIndexes, points);
+}
+
+const vector<PointIndex>& SubsetDataset::getPointIndexes()
+{
+    return *pointIndexes;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Dataset.h"
+
+// A dataset presenting some data points of another dataset, in the given order. Accessing a
+// point accesses the other dataset, which must outlive the subset. Cursors read their own
+// cursors of the other dataset, and share the indexes of the points.
+//
+// A block is gathered from the other dataset at once, so that a dataset reading points from
+// files reads each of its segments once per block, instead of once per point.
+class SubsetDataset: public Dataset{
+public:
+    SubsetDataset(Dataset& source, std::shared_ptr<const std::vector<PointIndex>> pointIndexes);
+
+    PointView point(PointIndex pointIndex) override;
+    BlockView getBlock(PointIndex startX, PointIndex endX) override;
+    void gather(const std::vector<PointIndex>& pointIndexes, RowMajorMatrixXf& points) override;
+    std::unique_ptr<Dataset> createCursor() override;
+
+    // Shape is (size()). Indexes of the points in the other dataset.
+    const std::vector<PointIndex>& getPointIndexes();
+
+private:
+    // used by createCursor().
+    SubsetDataset(std::unique_ptr<Dataset> sourceCursor,
+                  std::shared_ptr<const std::vector<PointIndex>> pointIndexes);
+
+private:
+    Dataset* source;
+    std::unique_ptr<Dataset> sourceCursor;   // owns source, if this is a cursor.
+
+    std::shared_ptr<const std::vector<PointIndex>> pointIndexes;
+
+    // points of the last block returned by getBlock().
+    std::vector<PointIndex> blockIndexes;
+    RowMajorMatrixXf blockPoints;
+};
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <algorithm>
+#include "YinyangKmeansClusterer.h"
+
+using namespace std;
+using namespace Eigen;
+
+YinyangKmeansClusterer::YinyangKmeansClusterer(Dataset& dataset, int K, int threadsNumber,
+                                               int groupsNumber_):
+    KmeansClusterer(dataset, K, threadsNumber)
+{
+    groupsNumber = groupsNumber_ > 0 ? groupsNumber_ : K / 10;
+    groupsNumber = std::max(1, std::min(groupsNumber, K));
+
+    centerMovements.assign(K, 0.0);
+    groupMovements.assign(groupsNumber, 0.0);
+
+    upperBounds.resize(N);
+    lowerBounds.resize(N, groupsNumber);
+}
+
+long YinyangKmeansClusterer::getBoundsMemory()
+{
+    return (lowerBounds.size() + upperBounds.size()) * sizeof(float);
+}
+
+void YinyangKmeansClusterer::groupCenters()
+{
+    // The initial centers are random data points, so the first ones are taken as the
+    // initial centers of groups.
+    vector<RowVectorXf> groupCenters(centers.begin(), centers.begin() + groupsNumber);
+    centerGroups.assign(K, 0);
+    for (int iteration=0; iteration<5; iteration++){
+        for (int c=0; c<K; c++){
+            float minDistance = numeric_limits<float>::max();
+            for (int g=0; g<groupsNumber; g++){
+                float distance = (centers[c] - groupCenters[g]).norm();
+                if (distance < minDistance){
+                    minDistance = distance;
+                    centerGroups[c] = g;
+                }
+            }
+        }
+
+        // an empty group keeps its center.
+        vector<RowVectorXf> sums(groupsNumber, RowVectorXf::Zero(vectorDimension));
+        vector<int> sizes(groupsNumber, 0);
+        for (int c=0; c<K; c++){
+            sums[ centerGroups[c] ] += centers[c];
+            sizes[ centerGroups[c] ]++;
+        }
+        for (int g=0; g<groupsNumber; g++){
+            if (sizes[g] > 0){
+                groupCenters[g] = sums[g] / sizes[g];
+            }
+        }
+    }
+
+    groups.assign(groupsNumber, vector<uint16_t>());
+    for (int c=0; c<K; c++){
+        groups[ centerGroups[c] ].push_back(c);
+    }
+}
+
+void YinyangKmeansClusterer::calculateInitialAssignment()
+{
+    groupCenters();
+
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        Dataset& threadDataset = *threadDatasets[thread];
+        vector<float> distances(K);
+        for (PointIndex x=startX; x<endX; x++){
+            PointView point = threadDataset.point(x);
+
+            // find the closest center.
+            uint16_t cx = 0;
+            for (int c=0; c<K; c++){
+                distances[c] = pointToCenterDistance(point, c);
+                if (distances[c] < distances[cx]){
+                    cx = c;
+                }
+            }
+            assignments[x] = cx;
+            upperBounds[x] = distances[cx];
+
+            // the lower bound of a group is the closest distance to its other centers.
+            for (int g=0; g<groupsNumber; g++){
+                float minDistance = numeric_limits<float>::max();
+                for (uint16_t c: groups[g]){
+                    if (c != cx){
+                        minDistance = std::min(minDistance, distances[c]);
+                    }
+                }
+                lowerBounds(x, g) = minDistance;
+            }
+        }
+    });
+}
+
+void YinyangKmeansClusterer::assignPoints(int thread, PointIndex startX, PointIndex endX)
+{
+    Dataset& threadDataset = *threadDatasets[thread];
+    ThreadState& state = threadStates[thread];
+
+    // For each examined group, the two smallest bounds of distances to its centers, and the
+    // center of the smallest one, so that the bound of the group can exclude the center
+    // finally assigned.
+    vector<float> smallest(groupsNumber);
+    vector<float> secondSmallest(groupsNumber);
+    vector<int>   smallestCenter(groupsNumber);
+    vector<bool>  examined(groupsNumber);
+
+    for (PointIndex x=startX; x<endX; x++){
+        // global filtering.
+        const uint16_t previousAssignment = assignments[x];
+        float globalLowerBound = lowerBounds.row(x).minCoeff();
+        if ( upperBounds[x] <= globalLowerBound ){
+            continue;
+        }
+
+        // tighten the upper bound, and test again.
+        PointView point = threadDataset.point(x);
+        const float previousDistance = pointToCenterDistance(point, previousAssignment);
+        upperBounds[x] = previousDistance;
+        if ( upperBounds[x] <= globalLowerBound ){
+            continue;
+        }
+
+        uint16_t cx = previousAssignment;
+        float closestDistance = previousDistance;
+        for (int g=0; g<groupsNumber; g++){
+            // group filtering.
+            examined[g] = lowerBounds(x, g) < closestDistance;
+            if ( !examined[g] ){
+                continue;
+            }
+
+            // The bound of the group before the centers moved. A center moved by m is at
+            // least this minus m away.
+            float previousGroupBound = lowerBounds(x, g) + groupMovements[g];
+            smallest[g] = secondSmallest[g] = numeric_limits<float>::max();
+            smallestCenter[g] = -1;
+            for (uint16_t c: groups[g]){
+                float bound;
+                if (c == previousAssignment){
+                    bound = previousDistance;
+                }else{
+                    // local filtering.
+                    bound = previousGroupBound - centerMovements[c];
+                    if (bound < closestDistance){
+                        bound = pointToCenterDistance(point, c);
+                        state.numberOfDistanceCalculation++;
+                        if (bound < closestDistance){
+                            closestDistance = bound;
+                            cx = c;
+                        }
+                    }
+                }
+
+                if (bound < smallest[g]){
+                    secondSmallest[g] = smallest[g];
+                    smallest[g] = bound;
+                    smallestCenter[g] = c;
+                }else if (bound < secondSmallest[g]){
+                    secondSmallest[g] = bound;
+                }
+            }
+        }
+
+        // update bounds of the examined groups, excluding the assigned center.
+        for (int g=0; g<groupsNumber; g++){
+            if (examined[g]){
+                lowerBounds(x, g) = (smallestCenter[g] == cx) ? secondSmallest[g] : smallest[g];
+            }
+        }
+        upperBounds[x] = closestDistance;
+
+        if (cx != previousAssignment){
+            // The previous center now counts in the bound of its group.
+            int previousGroup = centerGroups[previousAssignment];
+            lowerBounds(x, previousGroup) = std::min(lowerBounds(x, previousGroup),
+                                                     previousDistance);
+
+            assignments[x] = cx;
+            state.assignmentChanged = true;
+
+            // keep the sums of clusters up to date.
+            moveAssignment(thread, point, previousAssignment, cx);
+        }
+    }
+}
+
+void YinyangKmeansClusterer::updateBounds(PointIndex startX, PointIndex endX)
+{
+    for (PointIndex x=startX; x<endX; x++){
+        uint16_t cx = assignments[x];
+        upperBounds[x] += centerMovements[cx];
+        for (int g=0; g<groupsNumber; g++){
+            lowerBounds(x, g) -= groupMovements[g];
+        }
+    }
+}
+
+void YinyangKmeansClusterer::runOneIteration()
+{
+    forEachThreadRange([&](int thread, PointIndex startX, PointIndex endX){
+        assignPoints(thread, startX, endX);
+    });
+    reduceThreadStates();
+
+    // move the centers.
+    vector<RowVectorXf> newCenters;
+    calculateNewCenters(newCenters);
+    groupMovements.assign(groupsNumber, 0.0);
+    for (int c=0; c<K; c++){
+        centerMovements[c] = centerToNewCenterDistance(c, newCenters[c] );
+        int g = centerGroups[c];
+        groupMovements[g] = std::max(groupMovements[g], centerMovements[c]);
+    }
+
+    forEachThreadRange([&](int, PointIndex startX, PointIndex endX){
+        updateBounds(startX, endX);
+    });
+
+    centers = newCenters;
+}
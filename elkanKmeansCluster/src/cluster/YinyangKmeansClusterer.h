@@ -0,0 +1,61 @@
+#pragma once
+
+#include "KmeansClusterer.h"
+
+// Yinyang k-means. The centers are grouped once, by clustering the initial centers, and for
+// each point it keeps an upper bound of the distance to its center and a lower bound of the
+// distances to the centers of each group, so bounds take O(N*G) memory for G groups.
+//
+// A point is skipped if its upper bound is below all group lower bounds (global filtering).
+// Otherwise only groups whose lower bounds are below the upper bound are examined (group
+// filtering), and in these groups a center is skipped if its own bound, derived from the
+// group lower bound and the movement of the center, is not closer (local filtering).
+class YinyangKmeansClusterer: public KmeansClusterer {
+public:
+    // If groupsNumber is 0, K/10 groups are used.
+    YinyangKmeansClusterer(Dataset& dataset, int K, int threadsNumber = 1,
+                           int groupsNumber = 0);
+
+    long getBoundsMemory() override;
+
+protected:
+    // higher level functions.
+    void calculateInitialAssignment() override;
+
+    void runOneIteration() override;
+
+private:
+    // middle level functions.
+    // group the initial centers by a few iterations of k-means on them.
+    void groupCenters();
+
+    // assign the points in [startX, endX) to their closest centers.
+    void assignPoints(int thread, PointIndex startX, PointIndex endX);
+
+    // update bounds of the points in [startX, endX) after centers move.
+    void updateBounds(PointIndex startX, PointIndex endX);
+
+private:
+    int groupsNumber;
+
+    // Shape is (groupsNumber). Centers in each group.
+    vector< vector<uint16_t> > groups;
+
+    // Shape is (K). Group of each center.
+    vector<int> centerGroups;
+
+    // Shape is (K). Movement of each center in the last iteration.
+    vector<float> centerMovements;
+
+    // Shape is (groupsNumber). The largest movement of the centers of each group in the
+    // last iteration.
+    vector<float> groupMovements;
+
+    // Shape is (N). Stores "u(x)".
+    RowVectorXf upperBounds;
+
+    // Shape is (N, groupsNumber). Stores "l(x,g)", a lower bound of the distances to the
+    // centers of group g, except the assigned center. Row-major, as the bounds of a point
+    // are accessed together.
+    RowMajorMatrixXf lowerBounds;
+};
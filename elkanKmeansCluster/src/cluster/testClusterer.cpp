@@ -9,16 +9,25 @@ class TestDataset: public Dataset{
 public:
     TestDataset(){
         int N = 1000;
-        m = MatrixXf::Random(N, 2);
+        m = make_shared<RowMajorMatrixXf>( RowMajorMatrixXf::Random(N, 2) );
         setSize(N);
     };
 
-    Eigen::RowVectorXf operator()(int pointIndex) override{
-        return m.row(pointIndex);
+    PointView point(PointIndex pointIndex) override{
+        return PointView(m->row(pointIndex).data(), m->cols());
+    }
+
+    BlockView getBlock(PointIndex startX, PointIndex endX) override{
+        return BlockView(m->row(startX).data(), endX - startX, m->cols());
+    }
+
+    // cursors share the points, which are never modified.
+    unique_ptr<Dataset> createCursor() override{
+        return unique_ptr<Dataset>( new TestDataset(*this) );
     }
 
 private:
-    MatrixXf m;
+    shared_ptr<RowMajorMatrixXf> m;
 };
 
 void clusterSythesizedData()
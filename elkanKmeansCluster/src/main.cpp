@@ -1,15 +1,30 @@
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <limits>
 #include <random>
+#include <memory>
+#include <mutex>
 #include <options.h>
+#include <nanotimer.h>
 #include <h5pp/h5pp.h>
 #include <Eigen/Eigen>
 #include <fmt/core.h>
 #include <matplot/matplot.h>
 #include <matrixConversion.h>
 #include "cluster/ElkanKmeansClusterer.h"
+#include "cluster/HamerlyKmeansClusterer.h"
+#include "cluster/YinyangKmeansClusterer.h"
+#include "cluster/MiniBatchKmeansClusterer.h"
+#include "cluster/MultiRestartKmeans.h"
+#include "cluster/KmeansSweep.h"
+#include "cluster/BisectingKmeans.h"
+#include "cluster/KmeansAssigner.h"
+#include "cluster/CenterTree.h"
+#include "cluster/DenseDataset.h"
 #include "SegmentsDataset.h"
+#include "MappedDataset.h"
+#include "MultiFileDataset.h"
 
 void clusterSythesizedData();
 
@@ -18,16 +33,448 @@ using namespace options;
 using namespace Eigen;
 using namespace h5pp;
 
+void clusterAllPoints(Dataset& fileDataset, const string& inputFilename,
+                      const vector<string>& featureFilenames,
+                      const string& algorithm, int K, int threadsNumber, unsigned seed);
+unique_ptr<KmeansClusterer> createClusterer(Dataset& dataset, const string& algorithm, int K,
+                                            int threadsNumber, unsigned seed);
+KmeansClusterer::Seeding getSeeding();
+void loadClusteringState(const string& filename, ElkanKmeansClusterer& clusterer,
+                         PointIndex N, int K);
+void saveClusteringState(const string& filename, ElkanKmeansClusterer& clusterer);
+void saveCodebook(const vector<RowVectorXf>& centers, const CenterTree* tree = nullptr);
+void assignByCodebook(Dataset& dataset, const string& codebookFilename,
+                      const string& outputFilename, int threadsNumber);
+
+// read the names of feature files listed in a text file, one per line.
+vector<string> readFeatureList(const string& listFilename)
+{
+    ifstream listFile(listFilename);
+    if ( !listFile ){
+        throw runtime_error("cannot open feature list " + listFilename);
+    }
+
+    vector<string> filenames;
+    string line;
+    while ( getline(listFile, line) ){
+        if ( !line.empty() ){
+            filenames.push_back(line);
+        }
+    }
+    return filenames;
+}
+
 void clusterAudioData()
 {
     options::Options& ops = OptionsInstance::get();
-    File inputFeatureFile ( ops.getString("inputFeature"),  FilePermission::READONLY);
-    SegmentsDataset dataset(inputFeatureFile);
-    cout << "data points : " << dataset.size() << "\n";
 
-    // cluster the points.
-    ElkanKmeansClusterer clusterer(dataset, 16);
-    clusterer.cluster();
+    // The points are read from a single feature file, or from all feature files listed by
+    // the option 'inputFeatureList', which are concatenated as one dataset.
+    string inputFilename;
+    vector<string> featureFilenames;
+    unique_ptr<File> inputFeatureFile;
+    unique_ptr<SegmentsDataset> segmentsDataset;
+    unique_ptr<MultiFileDataset> multiFileDataset;
+    Dataset* fileDataset;
+    if ( ops.presents("inputFeatureList") ){
+        inputFilename = ops.getString("inputFeatureList");
+        featureFilenames = readFeatureList(inputFilename);
+        multiFileDataset.reset( new MultiFileDataset(featureFilenames,
+                                                     ops.getInt("maxOpenFiles", 16)) );
+        fileDataset = multiFileDataset.get();
+    }else{
+        inputFilename = ops.getString("inputFeature");
+        featureFilenames = { inputFilename };
+        inputFeatureFile.reset( new File(inputFilename, FilePermission::READONLY) );
+        segmentsDataset.reset( new SegmentsDataset(*inputFeatureFile) );
+        fileDataset = segmentsDataset.get();
+    }
+    cout << "data points : " << fileDataset->size() << "\n";
+
+    string algorithm = ops.presents("algorithm") ? ops.getString("algorithm") : "elkan";
+    int K = ops.getInt("K", 16);
+    int threadsNumber = ops.getInt("threadsNumber", 1);
+    unsigned seed = ops.getInt("seed", default_random_engine::default_seed);
+
+    // With a codebook, the points are only assigned to its centers, reading them once.
+    // Mini-batch k-means reads only a few segments per batch. So in both cases the points
+    // are read from the file directly, and memory does not grow with the number of points.
+    if ( ops.presents("codebook") ){
+        assignByCodebook(*fileDataset, ops.getString("codebook"),
+                         ops.getString("outputAssignments"), threadsNumber);
+    }else if (algorithm == "minibatch"){
+        MiniBatchKmeansClusterer clusterer(*fileDataset, K, threadsNumber,
+                                           ops.getInt("segmentsPerBatch", 16),
+                                           ops.getDouble("tolerance", 1e-3),
+                                           ops.getInt("maxBatches", 1000));
+        clusterer.setSeeding(getSeeding(), seed);
+        clusterer.cluster();
+        saveCodebook( clusterer.getCenters() );
+    }else{
+        clusterAllPoints(*fileDataset, inputFilename, featureFilenames, algorithm, K,
+                         threadsNumber, seed);
+    }
+
+    if (multiFileDataset){
+        multiFileDataset->printStatistics();
+    }else{
+        segmentsDataset->printStatistics();
+    }
+}
+
+// cluster the points by an engine which makes passes over all points.
+void clusterAllPoints(Dataset& fileDataset, const string& inputFilename,
+                      const vector<string>& featureFilenames,
+                      const string& algorithm, int K, int threadsNumber, unsigned seed)
+{
+    options::Options& ops = OptionsInstance::get();
+
+    // The clusterer makes many passes over all data points, so by default the points are
+    // loaded into memory once instead of being read from the file in every pass. If a
+    // feature cache is used, the points are mapped from the cache instead, which is
+    // validated against all feature files. A warm start reads only the appended points and
+    // the saved points whose bounds do not hold, so by default it reads them from the file.
+    Dataset* dataset = &fileDataset;
+    unique_ptr<Dataset> fastDataset;
+    const int loadByDefault = ops.presents("warmStart") ? 0 : 1;
+    if ( ops.getInt("useFeatureCache", 0) != 0 ){
+        fastDataset.reset( new MappedDataset(inputFilename + ".cache",
+                                             featureFilenames, fileDataset) );
+    }else if ( ops.getInt("loadDatasetIntoMemory", loadByDefault) != 0 ){
+        fastDataset.reset( new DenseDataset(fileDataset) );
+    }
+    if (fastDataset){
+        dataset = fastDataset.get();
+    }
+
+    // A sweep clusters the points into each of the K listed by the option 'sweepK', sharing
+    // the loaded points and the seed centers. With several restarts, they share the loaded
+    // points, and the best one is kept.
+    int restartsNumber = ops.getInt("restartsNumber", 1);
+    if (algorithm == "bisecting"){
+        // each split is 2-means by Elkan's k-means.
+        BisectingKmeans bisecting(*dataset, K, threadsNumber,
+            [&](Dataset& splitDataset, int splitThreadsNumber, unsigned splitSeed){
+                return createClusterer(splitDataset, "elkan", 2, splitThreadsNumber, splitSeed);
+            });
+        bisecting.cluster(seed);
+        saveCodebook( bisecting.getCenters(), &bisecting.getTree() );
+    }else if ( ops.presents("sweepK") ){
+        KmeansSweep sweep(*dataset, ops.getVectorInt("sweepK"), threadsNumber,
+            [&](Dataset& runDataset, int runK, int runThreadsNumber){
+                return createClusterer(runDataset, algorithm, runK, runThreadsNumber, seed);
+            });
+        sweep.cluster();
+        if ( ops.presents("outputSweepTable") ){
+            sweep.writeTable( ops.getString("outputSweepTable") );
+        }
+    }else if (restartsNumber > 1){
+        MultiRestartKmeans restarts(*dataset, restartsNumber, threadsNumber,
+            [&](Dataset& restartDataset, int restartThreadsNumber, unsigned restartSeed){
+                return createClusterer(restartDataset, algorithm, K, restartThreadsNumber,
+                                       restartSeed);
+            });
+        restarts.cluster(seed);
+        saveCodebook( restarts.getBestClusterer().getCenters() );
+    }else{
+        unique_ptr<KmeansClusterer> clusterer = createClusterer(*dataset, algorithm, K,
+                                                                threadsNumber, seed);
+
+        // A clustering can be saved, and later continued on the points appended since, by
+        // Elkan's k-means only.
+        ElkanKmeansClusterer* elkan = dynamic_cast<ElkanKmeansClusterer*>(clusterer.get());
+        if ( (ops.presents("warmStart") || ops.presents("outputClusteringState")) && !elkan ){
+            cout << "warmStart and outputClusteringState need the algorithm elkan\n";
+            exit(-1);
+        }
+        if ( ops.presents("warmStart") ){
+            loadClusteringState(ops.getString("warmStart"), *elkan, dataset->size(), K);
+        }
+        clusterer->cluster();
+        saveCodebook( clusterer->getCenters() );
+        if ( ops.presents("outputClusteringState") ){
+            saveClusteringState(ops.getString("outputClusteringState"), *elkan);
+        }
+    }
+}
+
+// start clustering from a state saved by saveClusteringState(), whose points are the first
+// N points of the dataset. Bounds are optional in the state.
+void loadClusteringState(const string& filename, ElkanKmeansClusterer& clusterer,
+                         PointIndex N, int K)
+{
+    RowMajorMatrixXf centers;
+    vector<uint16_t> assignments;
+    RowVectorXf upperBounds;
+    RowMajorMatrixXf lowerBounds;
+    {
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        File stateFile(filename, FilePermission::READONLY);
+        stateFile.readDataset(centers, "/centers");
+        stateFile.readDataset(assignments, "/assignments");
+        if ( stateFile.linkExists("/upperBounds") && stateFile.linkExists("/lowerBounds") ){
+            stateFile.readDataset(upperBounds, "/upperBounds");
+            stateFile.readDataset(lowerBounds, "/lowerBounds");
+        }
+    }
+
+    const PointIndex clusteredN = assignments.size();
+    if ( centers.rows() != K || clusteredN > N ||
+         (upperBounds.size() > 0 && (upperBounds.size() != clusteredN ||
+                                     lowerBounds.rows() != clusteredN ||
+                                     lowerBounds.cols() != K)) ){
+        cout << "the clustering state " << filename << " does not match the dataset\n";
+        exit(-1);
+    }
+    cout << "warm start from " << filename << ": " << assignments.size()
+         << " points clustered, " << N - assignments.size() << " points appended, "
+         << (upperBounds.size() > 0 ? "with" : "without") << " bounds\n";
+    clusterer.setWarmStart(centers, assignments, upperBounds, lowerBounds);
+}
+
+// Shape is (K, vectorDimension). The centers, one per row.
+RowMajorMatrixXf toCentersMatrix(const vector<RowVectorXf>& centers)
+{
+    RowMajorMatrixXf centersMatrix(centers.size(), centers[0].cols());
+    for (size_t c=0; c<centers.size(); c++){
+        centersMatrix.row(c) = centers[c];
+    }
+    return centersMatrix;
+}
+
+// save the centers, the assignments and the bounds of a clustering, for a warm start.
+void saveClusteringState(const string& filename, ElkanKmeansClusterer& clusterer)
+{
+    RowMajorMatrixXf centersMatrix = toCentersMatrix( clusterer.getCenters() );
+    RowVectorXf upperBounds;
+    RowMajorMatrixXf lowerBounds;
+    clusterer.getBounds(upperBounds, lowerBounds);
+
+    lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+    File stateFile(filename, FilePermission::REPLACE);
+    stateFile.writeDataset(centersMatrix, "/centers");
+    stateFile.writeDataset(clusterer.getAssignments(), "/assignments");
+    stateFile.writeDataset(upperBounds, "/upperBounds");
+    stateFile.writeDataset(lowerBounds, "/lowerBounds");
+}
+
+// save the centers as a codebook "/centers" to the file given by the option 'outputCodebook',
+// if given, for assigning other features by the option 'codebook'. A tree of the centers is
+// saved as "/treeCenters", "/treeChildren" and "/treeLeaves", in the shapes of
+// CenterTree::getNodes().
+void saveCodebook(const vector<RowVectorXf>& centers, const CenterTree* tree)
+{
+    options::Options& ops = OptionsInstance::get();
+    if ( !ops.presents("outputCodebook") ){
+        return;
+    }
+
+    lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+    File codebookFile(ops.getString("outputCodebook"), FilePermission::REPLACE);
+    codebookFile.writeDataset(toCentersMatrix(centers), "/centers");
+    if (tree){
+        RowMajorMatrixXf treeCenters;
+        RowMajorMatrixXi treeChildren;
+        vector<int> treeLeaves;
+        tree->getNodes(treeCenters, treeChildren, treeLeaves);
+        codebookFile.writeDataset(treeCenters,  "/treeCenters");
+        codebookFile.writeDataset(treeChildren, "/treeChildren");
+        codebookFile.writeDataset(treeLeaves,   "/treeLeaves");
+    }
+}
+
+// assign all points to the closest centers of a codebook, and write the assignments to
+// "/assignments" and the distances to "/distances" of the output file. If the codebook has a
+// tree of its centers, e.g. of bisecting k-means, points are assigned to the leaves found by
+// descending the tree instead. Points are assigned chunk by chunk, each chunk by all threads,
+// and each chunk is written when assigned.
+void assignByCodebook(Dataset& dataset, const string& codebookFilename,
+                      const string& outputFilename, int threadsNumber)
+{
+    nanotimer timer;
+    timer.start();
+
+    RowMajorMatrixXf centers;
+    RowMajorMatrixXf treeCenters;
+    RowMajorMatrixXi treeChildren;
+    vector<int> treeLeaves;
+    {
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        File codebookFile(codebookFilename, FilePermission::READONLY);
+        codebookFile.readDataset(centers, "/centers");
+        if ( codebookFile.linkExists("/treeChildren") ){
+            codebookFile.readDataset(treeCenters,  "/treeCenters");
+            codebookFile.readDataset(treeChildren, "/treeChildren");
+            codebookFile.readDataset(treeLeaves,   "/treeLeaves");
+        }
+    }
+    const bool hasTree = treeChildren.size() > 0;
+    if ( centers.rows() == 0 || centers.rows() > 65536 ||
+         centers.cols() != dataset.point(0).cols() ||
+         (hasTree && (treeChildren.cols() != 2 || treeCenters.rows() != treeChildren.rows() ||
+                      PointIndex(treeLeaves.size()) != treeChildren.rows() ||
+                      treeCenters.cols() != centers.cols())) ){
+        cout << "the codebook " << codebookFilename << " does not match the features\n";
+        exit(-1);
+    }
+    // The K*K distances between centers of the assigner are not needed with a tree, whose K
+    // may be large.
+    unique_ptr<KmeansAssigner> assigner;
+    unique_ptr<CenterTree> tree;
+    if (hasTree){
+        tree.reset( new CenterTree(treeCenters, treeChildren, treeLeaves) );
+        if ( !tree->isValid(centers.rows()) ){
+            cout << "the tree of the codebook " << codebookFilename << " is invalid\n";
+            exit(-1);
+        }
+    }else{
+        assigner.reset( new KmeansAssigner(centers) );
+    }
+
+    // Each thread reads its own cursor.
+    threadsNumber = std::max(1, threadsNumber);
+    vector<Dataset*> threadDatasets(1, &dataset);
+    vector< unique_ptr<Dataset> > cursors;
+    for (int thread=1; thread<threadsNumber; thread++){
+        cursors.push_back( dataset.createCursor() );
+        threadDatasets.push_back( cursors.back().get() );
+    }
+
+    // create the outputs. The readers of threads may be accessing HDF5 in background, so
+    // the output file is accessed under the lock only.
+    const PointIndex N = dataset.size();
+    unique_ptr<File> outputFile;
+    unique_ptr<h5pp::hid::h5f> file;
+    hid_t assignmentsDataset, distancesDataset;
+    {
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        outputFile.reset( new File(outputFilename, FilePermission::REPLACE) );
+        file.reset( new h5pp::hid::h5f(outputFile->openFileHandle()) );
+        hsize_t dims[1] = { hsize_t(N) };
+        hid_t space = H5Screate_simple(1, dims, nullptr);
+        if (space < 0){
+            cout << "failed to create the dataspace of " << outputFilename << "\n";
+            exit(-1);
+        }
+        assignmentsDataset = H5Dcreate2(*file, "/assignments", H5T_NATIVE_UINT16, space,
+                                        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        distancesDataset   = H5Dcreate2(*file, "/distances", H5T_NATIVE_FLOAT, space,
+                                        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Sclose(space);
+        if (assignmentsDataset < 0 || distancesDataset < 0){
+            cout << "failed to create the datasets of " << outputFilename << "\n";
+            exit(-1);
+        }
+    }
+    auto writeChunk = [&](hid_t dataset, hid_t type, PointIndex startX, PointIndex endX,
+                          const void* data){
+        hid_t fileSpace = H5Dget_space(dataset);
+        hsize_t offset[1] = { hsize_t(startX) };
+        hsize_t count[1]  = { hsize_t(endX - startX) };
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        hid_t memorySpace = H5Screate_simple(1, count, nullptr);
+        if ( H5Dwrite(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, data) < 0 ){
+            cout << "failed to write " << outputFilename << "\n";
+            exit(-1);
+        }
+        H5Sclose(memorySpace);
+        H5Sclose(fileSpace);
+    };
+
+    // Chunks and the parts of threads are whole blocks of the dataset.
+    const int blockLength = dataset.getBlockLength();
+    const PointIndex chunkLength = PointIndex(blockLength) * threadsNumber * 16;
+    vector<uint16_t> assignments(chunkLength);
+    vector<float> distances(chunkLength);
+    vector<long> threadCalculations(threadsNumber, 0);
+    for (PointIndex chunkStartX=0; chunkStartX<N; chunkStartX+=chunkLength){
+        PointIndex chunkEndX = std::min(chunkStartX + chunkLength, N);
+        PointIndex blocksNumber = (chunkEndX - chunkStartX + blockLength - 1) / blockLength;
+        runInThreads(threadsNumber, [&](int thread){
+            PointIndex startX = std::min(chunkEndX, chunkStartX +
+                                         blocksNumber * thread / threadsNumber * blockLength);
+            PointIndex endX   = std::min(chunkEndX, chunkStartX +
+                                         blocksNumber * (thread+1) / threadsNumber * blockLength);
+            if (startX < endX && tree){
+                tree->assign(*threadDatasets[thread], startX, endX,
+                             &assignments[startX - chunkStartX],
+                             &distances[startX - chunkStartX],
+                             threadCalculations[thread]);
+            }else if (startX < endX){
+                assigner->assign(*threadDatasets[thread], startX, endX,
+                                 &assignments[startX - chunkStartX],
+                                 &distances[startX - chunkStartX],
+                                 threadCalculations[thread]);
+            }
+        });
+
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        writeChunk(assignmentsDataset, H5T_NATIVE_UINT16, chunkStartX, chunkEndX,
+                   assignments.data());
+        writeChunk(distancesDataset, H5T_NATIVE_FLOAT, chunkStartX, chunkEndX,
+                   distances.data());
+    }
+    {
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        H5Dclose(assignmentsDataset);
+        H5Dclose(distancesDataset);
+        file.reset();
+        outputFile.reset();
+    }
+
+    long numberOfDistanceCalculation = 0;
+    for (long calculations: threadCalculations){
+        numberOfDistanceCalculation += calculations;
+    }
+    cout << "assigned " << N << " points to " << centers.rows() << " centers"
+         << (tree ? " of a tree" : "") << " by " << threadsNumber << " threads\n";
+    cout << "total number of distance calculation: " << numberOfDistanceCalculation
+         << " (" << double(numberOfDistanceCalculation) / N << " per point)\n";
+    cout << "total assigning spent: " << timer.get_elapsed_ms() << " ms\n";
+}
+
+// create the clusterer of the given algorithm, seeded by the options.
+unique_ptr<KmeansClusterer> createClusterer(Dataset& dataset, const string& algorithm, int K,
+                                            int threadsNumber, unsigned seed)
+{
+    options::Options& ops = OptionsInstance::get();
+
+    // Elkan's k-means prunes the most distance calculations, but its bounds take O(N*K)
+    // memory; Hamerly's k-means takes O(N), and Yinyang k-means takes O(N*G) for G groups
+    // of centers, which suits medium K.
+    unique_ptr<KmeansClusterer> clusterer;
+    if (algorithm == "elkan"){
+        clusterer.reset( new ElkanKmeansClusterer(dataset, K, threadsNumber,
+                                                  ops.getInt("halfPrecisionBounds", 0) != 0) );
+    }else if (algorithm == "hamerly"){
+        clusterer.reset( new HamerlyKmeansClusterer(dataset, K, threadsNumber) );
+    }else if (algorithm == "yinyang"){
+        clusterer.reset( new YinyangKmeansClusterer(dataset, K, threadsNumber,
+                                                    ops.getInt("groupsNumber", 0)) );
+    }else{
+        cout << "unknown algorithm " << algorithm << "\n";
+        exit(-1);
+    }
+
+    clusterer->setSeeding(getSeeding(), seed);
+    return clusterer;
+}
+
+// the seeding method given by the option 'seeding'.
+KmeansClusterer::Seeding getSeeding()
+{
+    options::Options& ops = OptionsInstance::get();
+    string seeding = ops.presents("seeding") ? ops.getString("seeding") : "uniform";
+    if (seeding == "uniform"){
+        return KmeansClusterer::UniformSeeding;
+    }else if (seeding == "kmeans++"){
+        return KmeansClusterer::KmeansPlusPlusSeeding;
+    }else if (seeding == "kmeansParallel"){
+        return KmeansClusterer::KmeansParallelSeeding;
+    }else{
+        cout << "unknown seeding " << seeding << "\n";
+        exit(-1);
+    }
 }
 
 int main(int argc, char* argv[])
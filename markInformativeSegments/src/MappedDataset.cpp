@@ -0,0 +1,167 @@
+#include <cstring>
+#include <cassert>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <nanotimer.h>
+#include "MappedDataset.h"
+
+using namespace std;
+
+static const char magic[8] = {'F','E','A','T','C','A','C','H'};
+static const uint32_t version = 2;
+// points start at a page boundary, so that they are aligned in the mapping.
+static const uint32_t headerBytes = 4096;
+
+MappedDataset::MappedDataset(const string& cacheFilename,
+                             const vector<string>& sourceFilenames, Dataset& source)
+{
+    // A valid cache is used without reading any point of the source.
+    Header header = makeHeader(sourceFilenames, source);
+    if ( !isValid(cacheFilename, header) ){
+        header.cols = source.point(0).cols();
+        write(cacheFilename, header, source);
+    }else{
+        cout << "use feature cache " << cacheFilename << "\n";
+    }
+
+    map(cacheFilename);
+    vectorDimension = header.cols;
+    setSize(header.rows);
+}
+
+unique_ptr<Dataset> MappedDataset::createCursor()
+{
+    return unique_ptr<Dataset>( new MappedDataset(*this) );
+}
+
+// FNV-1a.
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t bytes)
+{
+    for (size_t i=0; i<bytes; i++){
+        hash = (hash ^ ((const unsigned char*)data)[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+MappedDataset::Header MappedDataset::makeHeader(const vector<string>& sourceFilenames,
+                                                Dataset& source)
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version     = version;
+    header.headerBytes = headerBytes;
+    header.rows        = source.size();
+    header.sourceHash  = 0xcbf29ce484222325ULL;
+    for (const string& sourceFilename: sourceFilenames){
+        int64_t size = filesystem::file_size(sourceFilename);
+        int64_t modificationTime =
+            filesystem::last_write_time(sourceFilename).time_since_epoch().count();
+        header.sourceSize += size;
+        header.sourceModificationTime = std::max(header.sourceModificationTime,
+                                                 modificationTime);
+
+        uint64_t& hash = header.sourceHash;
+        hash = hashBytes(hash, sourceFilename.data(), sourceFilename.size());
+        hash = hashBytes(hash, &size, sizeof(size));
+        hash = hashBytes(hash, &modificationTime, sizeof(modificationTime));
+    }
+
+    return header;
+}
+
+bool MappedDataset::isValid(const string& cacheFilename, Header& expected)
+{
+    ifstream file(cacheFilename, ios::binary);
+    if ( !file ){
+        return false;
+    }
+
+    Header header;
+    file.read( (char*)&header, sizeof(header) );
+    if ( !file ){
+        return false;
+    }
+
+    Header cached = expected;
+    cached.cols = header.cols;
+    long expectedBytes = headerBytes + cached.rows * cached.cols * sizeof(float);
+    if ( header.cols <= 0 || memcmp(&header, &cached, sizeof(header)) != 0 ||
+         (long)filesystem::file_size(cacheFilename) != expectedBytes ){
+        return false;
+    }
+    expected.cols = header.cols;
+    return true;
+}
+
+void MappedDataset::write(const string& cacheFilename, const Header& header, Dataset& source)
+{
+    nanotimer timer;
+    timer.start();
+    cout << "write feature cache " << cacheFilename << "\n";
+
+    // write to a temporary file first, so that an interrupted writing never leaves a cache
+    // which looks valid.
+    string temporaryFilename = cacheFilename + ".tmp";
+    {
+        ofstream file(temporaryFilename, ios::binary | ios::trunc);
+        vector<char> paddedHeader(headerBytes, 0);
+        memcpy(paddedHeader.data(), &header, sizeof(header));
+        file.write(paddedHeader.data(), paddedHeader.size());
+
+        const PointIndex N = header.rows;
+        const int blockLength = source.getBlockLength();
+        for (PointIndex startX=0; startX<N; startX+=blockLength){
+            PointIndex endX = std::min(startX + blockLength, N);
+            BlockView block = source.getBlock(startX, endX);
+            file.write( (const char*)block.data(), block.size() * sizeof(float) );
+        }
+
+        if ( !file ){
+            throw runtime_error("failed to write feature cache " + temporaryFilename);
+        }
+    }
+    filesystem::rename(temporaryFilename, cacheFilename);
+
+    cout << "feature cache written, spent " << timer.get_elapsed_ms() << " ms\n";
+}
+
+void MappedDataset::map(const string& cacheFilename)
+{
+    int fd = open(cacheFilename.c_str(), O_RDONLY);
+    if (fd < 0){
+        throw runtime_error("cannot open feature cache " + cacheFilename);
+    }
+
+    struct stat status;
+    fstat(fd, &status);
+    size_t mappingBytes = status.st_size;
+    void* address = mmap(nullptr, mappingBytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED){
+        throw runtime_error("cannot map feature cache " + cacheFilename);
+    }
+    mapping = shared_ptr<const void>(address, [mappingBytes](const void* address){
+        munmap( (void*)address, mappingBytes );
+    });
+
+    points = (const float*)( (const char*)address + headerBytes );
+}
+
+PointView MappedDataset::point(PointIndex pointIndex)
+{
+    assert( pointIndex < size() );
+    return PointView(points + pointIndex * vectorDimension, vectorDimension);
+}
+
+BlockView MappedDataset::getBlock(PointIndex startX, PointIndex endX)
+{
+    assert( startX < endX && endX <= size() );
+    return BlockView(points + startX * vectorDimension, endX - startX, vectorDimension);
+}
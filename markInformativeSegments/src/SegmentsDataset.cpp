@@ -1,4 +1,6 @@
 #include <limits>
+#include <map>
+#include <mutex>
 #include <options.h>
 #include "SegmentsDataset.h"
 
@@ -8,9 +10,14 @@ SegmentsDataset::SegmentsDataset(h5pp::File& h5File_):
     h5File(h5File_)
 {
     cachedSegment = -1;
+    cachedMatrix  = nullptr;
 
-    h5File.readDataset(segmentsNumber,   "/segmentsNumber");
-    h5File.readDataset(framesPerSegment, "/framesPerSegment");
+    {
+        // other datasets over the file may be reading in background.
+        lock_guard<mutex> lock(SegmentReader::hdf5Mutex);
+        h5File.readDataset(segmentsNumber,   "/segmentsNumber");
+        h5File.readDataset(framesPerSegment, "/framesPerSegment");
+    }
 
     assert( double(segmentsNumber) * double(framesPerSegment) <
             double( numeric_limits<int>::max() ) );
@@ -23,6 +30,39 @@ SegmentsDataset::SegmentsDataset(h5pp::File& h5File_):
     }
 
     setSize(framesNumber);
+    createReader();
+
+    long cacheBudget = ops.getInt("segmentCacheMB", 256) * 1024L * 1024L;
+    cache = make_shared<SegmentCache>(cacheBudget);
+}
+
+SegmentsDataset::SegmentsDataset(h5pp::File& h5File_, int segmentsNumber_,
+                                 int framesPerSegment_, int framesNumber,
+                                 shared_ptr<SegmentCache> cache_):
+    h5File(h5File_), segmentsNumber(segmentsNumber_), framesPerSegment(framesPerSegment_),
+    cache(cache_)
+{
+    cachedSegment = -1;
+    cachedMatrix  = nullptr;
+
+    setSize(framesNumber);
+    createReader();
+}
+
+void SegmentsDataset::createReader()
+{
+    options::Options& ops = options::OptionsInstance::get();
+
+    // Only segments containing the used frames are read.
+    int usedSegmentsNumber = (size() + framesPerSegment - 1) / framesPerSegment;
+    reader.reset( new SegmentReader(h5File, "features", usedSegmentsNumber,
+                                    ops.getInt("prefetchDepth", 2)) );
+}
+
+unique_ptr<Dataset> SegmentsDataset::createCursor()
+{
+    return unique_ptr<Dataset>(
+        new SegmentsDataset(h5File, segmentsNumber, framesPerSegment, size(), cache) );
 }
 
 int SegmentsDataset::getSegmentsNumber()
@@ -36,20 +76,91 @@ void SegmentsDataset::getSegmentRange(int segmentID, int& startX, int& endX)
     endX   = startX + framesPerSegment;
 }
 
-Eigen::RowVectorXf SegmentsDataset::operator()(int pointIndex)
+void SegmentsDataset::loadSegment(int segment)
 {
-    assert( pointIndex < size() );
-
-    int segment = pointIndex / framesPerSegment;
     if (segment != cachedSegment ){
-        h5File.readDataset(cachedMatrix,
-                           fmt::format("segments/{}/features", segment) );
+        cachedMatrix = cache->find(segment);
+        if (cachedMatrix == nullptr){
+            RowMajorMatrixXf matrix;
+            reader->read(segment, matrix);
+            cachedMatrix = cache->insert(segment, matrix);
+        }
         cachedSegment = segment;
         //cout << "read in segment " << cachedSegment << "\n";
     }else{
         //cout << "hit cache\n";
     }
+}
+
+PointView SegmentsDataset::point(PointIndex pointIndex)
+{
+    assert( pointIndex < size() );
+
+    int segment = pointIndex / framesPerSegment;
+    loadSegment(segment);
 
     int frame = pointIndex % framesPerSegment;
-    return cachedMatrix.row(frame);
+    return PointView(cachedMatrix->row(frame).data(), cachedMatrix->cols());
+}
+
+BlockView SegmentsDataset::getBlock(PointIndex startX, PointIndex endX)
+{
+    assert( startX < endX && endX <= size() );
+
+    int segment = startX / framesPerSegment;
+    if ( (endX - 1) / framesPerSegment != segment ){
+        return Dataset::getBlock(startX, endX);
+    }
+    loadSegment(segment);
+
+    int frame = startX % framesPerSegment;
+    return BlockView(cachedMatrix->row(frame).data(), endX - startX, cachedMatrix->cols());
+}
+
+void SegmentsDataset::gather(const vector<PointIndex>& pointIndexes, RowMajorMatrixXf& points)
+{
+    // group the points by segments. For each segment, keep positions of its points in
+    // pointIndexes.
+    map<int, vector<int> > positionsOfSegments;
+    for (size_t i=0; i<pointIndexes.size(); i++){
+        assert( pointIndexes[i] < size() );
+        positionsOfSegments[ pointIndexes[i] / framesPerSegment ].push_back(i);
+    }
+
+    points.resize(0, 0);
+    for (auto& [segment, positions]: positionsOfSegments){
+        vector<int> frames;
+        for (int i: positions){
+            frames.push_back( pointIndexes[i] % framesPerSegment );
+        }
+
+        RowMajorMatrixXf rows;
+        SegmentCache::Matrix matrix = cache->find(segment);
+        if (matrix != nullptr){
+            rows.resize(frames.size(), matrix->cols());
+            for (size_t k=0; k<frames.size(); k++){
+                rows.row(k) = matrix->row( frames[k] );
+            }
+        }else{
+            reader->readRows(segment, frames, rows);
+        }
+
+        if (points.rows() == 0){
+            points.resize(pointIndexes.size(), rows.cols());
+        }
+        for (size_t k=0; k<positions.size(); k++){
+            points.row( positions[k] ) = rows.row(k);
+        }
+    }
+}
+
+int SegmentsDataset::getBlockLength()
+{
+    return framesPerSegment;
+}
+
+void SegmentsDataset::printStatistics()
+{
+    reader->printStatistics();
+    cache->printStatistics();
 }
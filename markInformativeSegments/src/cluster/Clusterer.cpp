@@ -18,7 +18,7 @@ using namespace Eigen;
 Clusterer::Clusterer(Dataset& dataset_):
     dataset(dataset_)
 {
-    vectorDimension = dataset(0).cols();    
+    vectorDimension = dataset.point(0).cols();    
     N = dataset.size();    
 }
 
@@ -26,18 +26,26 @@ void Clusterer::setEpsilon(int segmentStartX, int segmentEndX)
 {
     options::Options& ops = options::OptionsInstance::get();  
 
-    int pointsNumber = std::min<int>( 10,  segmentEndX - segmentStartX);
+    // A point needs another point of the segment to have a nearest distance. The epsilon of
+    // the previous segment is kept for a shorter segment.
+    if (segmentEndX - segmentStartX < 2){
+        return;
+    }
+
+    // all points of the segment, one per row.
+    BlockView segment = dataset.getBlock(segmentStartX, segmentEndX);
+
+    int pointsNumber = std::min<int>( 10,  segment.rows());
     vector<float> nearestDistances(pointsNumber, 0.0);
     for (int i=0; i < pointsNumber; i++){
-        int x1 = segmentStartX + rand() % (segmentEndX - segmentStartX);
-        float minDistance = numeric_limits<float>::max();
-        for (int x2=segmentStartX; x2< segmentEndX; x2++){
-            if ( x1==x2) continue;
-            float distance = pointToPointDistance(x1, x2);
-            if (distance < minDistance)
-                minDistance = distance;
-        }
-        nearestDistances[i] = minDistance;
+        int x1 = rand() % segment.rows();
+        // distances from x1 to all points of the segment, excluding x1 itself.
+        VectorXf squaredDistances =
+            (segment.rowwise() - segment.row(x1)).rowwise().squaredNorm();
+        squaredDistances[x1] = numeric_limits<float>::max();
+        numerOfDistanceCalculation += segment.rows() - 1;
+
+        nearestDistances[i] = sqrt( squaredDistances.minCoeff() );
     }
 
     // find the median
@@ -83,28 +91,18 @@ void Clusterer::updateRecentCenters(CenterID center)
     }
 }
 
-float Clusterer::pointToPointDistance(int x1, int x2)
-{
-    numerOfDistanceCalculation++;
-
-    RowVectorXf diff = dataset(x1) - dataset(x2);
-    return diff.norm();
-}
-
-float Clusterer::pointToCenterDistance(int pointIndex, uint16_t center)
+float Clusterer::pointToCenterDistance(const PointView& point, uint16_t center)
 {
     numerOfDistanceCalculation++;
 
-    RowVectorXf diff = dataset(pointIndex) - centers[center];
-    return diff.norm();
+    return (point - centers[center]).norm();
 }
 
 float Clusterer::centerToCenterDistance(uint16_t center1, uint16_t center2)
 {
     numerOfDistanceCalculation++;
 
-    RowVectorXf diff = centers[center1] - centers[center2];
-    return diff.norm();
+    return (centers[center1] - centers[center2]).norm();
 }
 
 void Clusterer::printStatus()
@@ -137,12 +135,12 @@ void Clusterer::printStatus()
     }
 }
 
-void Clusterer::findClosest(int x, const set<CenterID>& centers,
+void Clusterer::findClosest(const PointView& point, const set<CenterID>& centers,
                             float& minDistance, CenterID& closestCenter)
 {
     // search the closest.
     for (CenterID center: centers){
-        float distance = pointToCenterDistance(x, center);
+        float distance = pointToCenterDistance(point, center);
         if (distance < minDistance){
             minDistance   = distance;
             closestCenter = center;
@@ -151,6 +149,19 @@ void Clusterer::findClosest(int x, const set<CenterID>& centers,
 }
 
 void Clusterer::cluster(int x)
+{
+    clusterPoint(x, dataset.point(x));
+}
+
+void Clusterer::cluster(int startX, int endX)
+{
+    BlockView block = dataset.getBlock(startX, endX);
+    for (int x=startX; x<endX; x++){
+        clusterPoint(x, PointView(block.row(x - startX).data(), block.cols()) );
+    }
+}
+
+void Clusterer::clusterPoint(int x, const PointView& point)
 {
     // the centers could be empty, so we should initialize the following variables with
     // some certain values.
@@ -171,7 +182,7 @@ void Clusterer::cluster(int x)
     //cout << "\n";
 
     //search
-    findClosest(x, recentActiveCenters,
+    findClosest(point, recentActiveCenters,
                 minDistance, closestCenter);
     if ( minDistance < epsilon){
         //cout << "found a match in recent active centers, "
@@ -199,7 +210,7 @@ void Clusterer::cluster(int x)
     //cout << "\n";
 
     // search.
-    findClosest(x, remainingCenters,
+    findClosest(point, remainingCenters,
                 minDistance, closestCenter);
     if ( minDistance < epsilon){
         //cout << "found a match in remaining centers, "
@@ -214,7 +225,7 @@ void Clusterer::cluster(int x)
     //cout << "could not find any match in all centers, the closest: \n"
     //     << "  min distance   = " << minDistance << "\n"
     //     << "  closest center = " << closestCenter << "\n";
-    centers.push_back( dataset(x) );
+    centers.push_back( point );
     assignment  = centers.size() - 1;
     minDistance = 0.0;
     //cout << "created a new center, id = " << assignment << "\n";
@@ -274,12 +285,17 @@ void Clusterer::updateCenters()
     clusterVectorSums.fill(0.0);
     vector<int> clusterSizes(K, 0);
 
-    // accumulate
+    // accumulate. Points of the current segment are consecutive, so they are accessed
+    // as a block.
     assert( assignments.size() == pointIndexes.size() );
-    for (int i=0; i<assignments.size(); i++){
-        int assignment = assignments[i];
-        clusterVectorSums.row(assignment) += dataset( pointIndexes[i] );
-        clusterSizes[assignment]++;
+    if ( !pointIndexes.empty() ){
+        BlockView segment = dataset.getBlock(pointIndexes.front(), pointIndexes.back() + 1);
+        assert( segment.rows() == int(pointIndexes.size()) );
+        for (size_t i=0; i<assignments.size(); i++){
+            int assignment = assignments[i];
+            clusterVectorSums.row(assignment) += segment.row(i);
+            clusterSizes[assignment]++;
+        }
     }
 
     // update the centers.
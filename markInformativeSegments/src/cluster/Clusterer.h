@@ -27,6 +27,8 @@ public:
 
     // cluster one data point.
     void cluster(int x);
+    // cluster consecutive data points [startX, endX), e.g. those of a segment.
+    void cluster(int startX, int endX);
 
     bool currentSegmentIsInformative();
 
@@ -52,17 +54,19 @@ public:
 private:
     // higher level functions.
 
+    // cluster a data point, given its index and a view of it.
+    void clusterPoint(int x, const PointView& point);
+
     // find the closest center among the set of centers, return the minimum distance and
     // the center.
-    void findClosest(int x, const std::set<CenterID>& centers,
+    void findClosest(const PointView& point, const std::set<CenterID>& centers,
                      float& minDistance, CenterID& closestCenter);
 
     void updateRecentCenters(CenterID center);
 
 private:    
     // lower level functions.
-    float pointToPointDistance(int x1, int x2);
-    float pointToCenterDistance(int pointIndex, uint16_t center);
+    float pointToCenterDistance(const PointView& point, uint16_t center);
     float centerToCenterDistance(uint16_t center1, uint16_t center2);
 
 public:
@@ -76,7 +80,8 @@ private:
     int N;
 
     // cluster radius. Any distance betwen a point and a center should be less than this.
-    float epsilon;
+    // Kept from the previous segment for a segment of fewer than 2 points.
+    float epsilon = 0.0;
 
     // k-th element is the center of the k-th cluster.
     vector< Eigen::RowVectorXf> centers;
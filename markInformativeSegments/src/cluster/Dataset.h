@@ -1,26 +1,92 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
+#include <vector>
+#include <memory>
 #include <Eigen/Eigen>
+#include "matrixConversion.h"
+
+// Index of a data point. It is 64-bit, so that a dataset may contain more points than an int
+// can count, e.g. when it spans many files.
+typedef int64_t PointIndex;
+
+// A read-only view of a data point. It refers to memory owned by a dataset, so no copying
+// is involved. The view is only guaranteed to be valid until the dataset is accessed again.
+typedef Eigen::Map<const Eigen::RowVectorXf> PointView;
+
+// A read-only view of consecutive data points, one per row. The same validity rule as for
+// PointView applies.
+typedef Eigen::Map<const RowMajorMatrixXf> BlockView;
 
 // This abstract class represents a set of all data points to be processed by
 // a k-means algorithm. Clients should derive a sub-class to describe data points.
 // We use an Eigen::RowVectorXf to represent a data point.
+//
+// A dataset may keep caching states while being accessed, so it must not be accessed by
+// more than one thread at a time. To read the data points from several threads, each
+// thread should use its own cursor created by createCursor(); cursors of a dataset can be
+// read concurrently.
 class Dataset {
 public:
     Dataset() : pointsNumber(0){};
+    virtual ~Dataset(){};
 
-    int size() const{
+    PointIndex size() const{
         return pointsNumber;
     };
 
-    virtual Eigen::RowVectorXf operator()(int pointIndex) = 0;
+    // return a view of a data point.
+    virtual PointView point(PointIndex pointIndex) = 0;
+
+    // return a new dataset presenting the same data points, with its own caching states.
+    virtual std::unique_ptr<Dataset> createCursor() = 0;
+
+    // return a copy of a data point.
+    Eigen::RowVectorXf operator()(PointIndex pointIndex){
+        return point(pointIndex);
+    };
+
+    // return a view of the data points in [startX, endX). This default implementation
+    // copies the points into a buffer; sub-classes storing points contiguously should
+    // override it to avoid copying.
+    virtual BlockView getBlock(PointIndex startX, PointIndex endX){
+        Eigen::RowVectorXf first = point(startX);
+        blockBuffer.resize(endX - startX, first.cols());
+        blockBuffer.row(0) = first;
+        for (PointIndex x=startX+1; x<endX; x++){
+            blockBuffer.row(x - startX) = point(x);
+        }
+        return BlockView(blockBuffer.data(), blockBuffer.rows(), blockBuffer.cols());
+    };
+
+    // copy the given data points into the rows of a matrix, in the given order. Sub-classes
+    // reading points from files should override it to read only the given points.
+    virtual void gather(const std::vector<PointIndex>& pointIndexes, RowMajorMatrixXf& points){
+        points.resize(0, 0);
+        for (size_t i=0; i<pointIndexes.size(); i++){
+            PointView p = point(pointIndexes[i]);
+            if (i == 0){
+                points.resize(pointIndexes.size(), p.cols());
+            }
+            points.row(i) = p;
+        }
+    };
+
+    // Length of blocks that can be returned by getBlock() without copying, if the blocks
+    // start from a multiple of the length.
+    virtual int getBlockLength(){
+        return 1024;
+    };
 
 protected:
-    void setSize(int pointsNumber_) {
+    void setSize(PointIndex pointsNumber_) {
         pointsNumber = pointsNumber_;
     };
 
 private:
-    int pointsNumber;  // number of data points.
+    PointIndex pointsNumber;  // number of data points.
+
+    // used by the default implementation of getBlock().
+    RowMajorMatrixXf blockBuffer;
 };
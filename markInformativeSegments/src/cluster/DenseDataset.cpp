@@ -0,0 +1,58 @@
+#include <cassert>
+#include <algorithm>
+#include <nanotimer.h>
+#include "DenseDataset.h"
+
+using namespace std;
+
+DenseDataset::DenseDataset(Dataset& source)
+{
+    nanotimer timer;
+    timer.start();
+
+    const PointIndex N = source.size();
+    const int vectorDimension = source.point(0).cols();
+
+    // Points are copied in blocks and in order, so that a dataset which reads its points
+    // in segments reads each segment only once.
+    shared_ptr<RowMajorMatrixXf> loadedPoints = make_shared<RowMajorMatrixXf>(N, vectorDimension);
+    const int blockLength = source.getBlockLength();
+    for (PointIndex startX=0; startX<N; startX+=blockLength){
+        PointIndex endX = std::min(startX + blockLength, N);
+        loadedPoints->middleRows(startX, endX - startX) = source.getBlock(startX, endX);
+    }
+    points = loadedPoints;
+    setSize(N);
+
+    cout << "loaded " << N << " data points into memory ("
+         << points->size() * sizeof(float) / (1024 * 1024) << " MB), spent "
+         << timer.get_elapsed_ms() << " ms\n";
+}
+
+DenseDataset::DenseDataset(shared_ptr<const RowMajorMatrixXf> points_):
+    points(points_)
+{
+    setSize(points->rows());
+}
+
+unique_ptr<Dataset> DenseDataset::createCursor()
+{
+    return unique_ptr<Dataset>( new DenseDataset(points) );
+}
+
+PointView DenseDataset::point(PointIndex pointIndex)
+{
+    assert( pointIndex < size() );
+    return PointView(points->row(pointIndex).data(), points->cols());
+}
+
+BlockView DenseDataset::getBlock(PointIndex startX, PointIndex endX)
+{
+    assert( startX < endX && endX <= size() );
+    return BlockView(points->row(startX).data(), endX - startX, points->cols());
+}
+
+const RowMajorMatrixXf& DenseDataset::getPoints()
+{
+    return *points;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Dataset.h"
+
+// A dataset which keeps all data points in memory, in a single row-major matrix. The points
+// are loaded from another dataset once, after which accessing a point is just taking a view
+// of a row of the matrix, involving neither I/O nor copying. Cursors share the matrix.
+class DenseDataset: public Dataset{
+public:
+    DenseDataset(Dataset& source);
+
+    PointView point(PointIndex pointIndex) override;
+    BlockView getBlock(PointIndex startX, PointIndex endX) override;
+    std::unique_ptr<Dataset> createCursor() override;
+
+    // Shape is (N, vectorDimension). All data points, one per row.
+    const RowMajorMatrixXf& getPoints();
+
+private:
+    // used by createCursor().
+    DenseDataset(std::shared_ptr<const RowMajorMatrixXf> points);
+
+private:
+    std::shared_ptr<const RowMajorMatrixXf> points;
+};
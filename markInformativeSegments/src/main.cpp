@@ -3,6 +3,8 @@
 #include <limits>
 #include <random>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <options.h>
 #include <nanotimer.h>
 #include <h5pp/h5pp.h>
@@ -11,8 +13,10 @@
 #include <matplot/matplot.h>
 #include <matrixConversion.h>
 #include "cluster/Clusterer.h"
+#include "cluster/DenseDataset.h"
 
 #include "SegmentsDataset.h"
+#include "MappedDataset.h"
 
 void testCluster();
 
@@ -57,17 +61,34 @@ int main(int argc, char* argv[])
 
     // input
     File inputFeatureFile ( ops.getString("inputFeature"),  FilePermission::READONLY);    
+
+    // output
+    // The result file is opened before the dataset, so that it is closed after the dataset
+    // has stopped reading in background.
+    string resultFilename = ops.getString("markingResult");
+    File resultFile(resultFilename,  FilePermission::REPLACE);
+
     SegmentsDataset dataset(inputFeatureFile);
     cout << "processing " << ops.getString("inputFeature") << "\n";
 
     // used in progress reporting.
     string basename = filesystem::path( ops.getString("inputFeature") ).stem().string();
 
-    // output
-    string resultFilename = ops.getString("markingResult");
-    File resultFile(resultFilename,  FilePermission::REPLACE);
+    // Optionally map the data points from a feature cache, or load them into memory, so
+    // that the clusterer accesses them without any reading or copying.
+    Dataset* clustererDataset = &dataset;
+    unique_ptr<Dataset> fastDataset;
+    if ( ops.getInt("useFeatureCache", 0) != 0 ){
+        fastDataset.reset( new MappedDataset(ops.getString("inputFeature") + ".cache",
+                                             { ops.getString("inputFeature") }, dataset) );
+    }else if ( ops.getInt("loadDatasetIntoMemory", 0) != 0 ){
+        fastDataset.reset( new DenseDataset(dataset) );
+    }
+    if (fastDataset){
+        clustererDataset = fastDataset.get();
+    }
 
-    Clusterer clusterer(dataset);        
+    Clusterer clusterer(*clustererDataset);        
 
     int totalSegments = dataset.getSegmentsNumber();
     vector<int> informativeSegments;    
@@ -97,19 +118,17 @@ int main(int argc, char* argv[])
 
         // process the current segment.
         clusterer.prepare();
-        int numberOfDistanceCalculationForClustering = 0;
-        for (int x=startX; x<endX; x++){
-            //cout << "\nprocessing point #" << x << "\n";
-            clusterer.clearNumerOfDistanceCalculation();
-            clusterer.cluster(x);            
-            numberOfDistanceCalculationForClustering += clusterer.getNumberOfDistanceCalculation();
-            // debug
-            //clusterer.printStatus();
-        }
+        clusterer.clearNumerOfDistanceCalculation();
+        clusterer.cluster(startX, endX);
+        int numberOfDistanceCalculationForClustering = clusterer.getNumberOfDistanceCalculation();
         numberOfDistanceCalculation += numberOfDistanceCalculationForClustering;
         cout << "numberOfDistanceCalculation for clustering: "
              << numberOfDistanceCalculationForClustering << "\n";
 
+        // The dataset may be reading following segments in background, and HDF5 can only
+        // be accessed by one thread at a time.
+        unique_lock<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
+
         // get assignments
         // Although each assignment has a type of 'int', we use float here so that this data
         // item can be more easily readed and converted to SonicViewer-readable data.
@@ -131,6 +150,7 @@ int main(int argc, char* argv[])
         float previousMaxCenterID = max( clusterer.getPreviousCentersNumber() - 1,  0);
         resultFile.writeDataset(previousMaxCenterID,
                             fmt::format("/segments/{}/previousMaxCenterID", segmentID) );
+        hdf5Lock.unlock();
 
         // get judegement.
         bool isInformative = clusterer.currentSegmentIsInformative();
@@ -187,8 +207,10 @@ int main(int argc, char* argv[])
     // The above processing time account for operations including the kernel clustering,
     // and some other extra operations such as reading input data, redandency detection and
     // removal.
+    dataset.printStatistics();
 
     // Save results.
+    lock_guard<mutex> hdf5Lock(SegmentReader::hdf5Mutex);
     resultFile.writeDataset(totalSegments, "/segmentsNumber");
     resultFile.writeDataset(informativeSegments, "/informativeSegments");
 }
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <cassert>
+#include "SegmentCache.h"
+
+using namespace std;
+
+static long matrixBytes(const RowMajorMatrixXf& matrix)
+{
+    return matrix.size() * sizeof(float);
+}
+
+SegmentCache::SegmentCache(long budgetBytes_):
+    budgetBytes(budgetBytes_)
+{
+    usedBytes = 0;
+    hits      = 0;
+    misses    = 0;
+    evictions = 0;
+}
+
+SegmentCache::Matrix SegmentCache::find(int segment)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(segment);
+    if (it == index.end()){
+        misses++;
+        return nullptr;
+    }
+
+    hits++;
+    segments.splice(segments.begin(), segments, it->second);
+    return it->second->second;
+}
+
+SegmentCache::Matrix SegmentCache::insert(int segment, RowMajorMatrixXf& matrix)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(segment);
+    if (it != index.end()){
+        segments.splice(segments.begin(), segments, it->second);
+        return it->second->second;
+    }
+
+    shared_ptr<RowMajorMatrixXf> cached = make_shared<RowMajorMatrixXf>();
+    cached->swap(matrix);
+    segments.emplace_front(segment, cached);
+    index[segment] = segments.begin();
+    usedBytes += matrixBytes(*cached);
+
+    // evict the least recently used segments, but never the one just inserted.
+    while (usedBytes > budgetBytes && segments.size() > 1){
+        usedBytes -= matrixBytes(*segments.back().second);
+        index.erase(segments.back().first);
+        segments.pop_back();
+        evictions++;
+    }
+
+    return cached;
+}
+
+long SegmentCache::getHits()
+{
+    lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+long SegmentCache::getMisses()
+{
+    lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+long SegmentCache::getEvictions()
+{
+    lock_guard<std::mutex> lock(mutex);
+    return evictions;
+}
+
+void SegmentCache::printStatistics()
+{
+    lock_guard<std::mutex> lock(mutex);
+    cout << "segment cache: "
+         << "hits " << hits << ", misses " << misses << ", evictions " << evictions << ", "
+         << "segments cached " << segments.size() << " ("
+         << usedBytes / (1024 * 1024) << " MB of " << budgetBytes / (1024 * 1024) << " MB)\n";
+}
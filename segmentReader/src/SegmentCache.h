@@ -0,0 +1,50 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "matrixConversion.h"
+
+// A cache of segment matrixes with a memory budget. When the budget is exceeded, the least
+// recently used segments are evicted. The most recently inserted segment is always kept,
+// even if it alone exceeds the budget.
+//
+// The cache may be shared by several datasets reading the same segments on different
+// threads, e.g. a dataset and its cursors, so that they share one budget. A returned matrix
+// is held by the caller, and stays valid after it is evicted, until the caller releases it.
+class SegmentCache{
+public:
+    typedef std::shared_ptr<const RowMajorMatrixXf> Matrix;
+
+    SegmentCache(long budgetBytes);
+
+    // return the cached matrix of the segment, or nullptr if it is not cached.
+    Matrix find(int segment);
+
+    // Move a matrix into the cache as the given segment, and return the cached matrix. If
+    // the segment has been inserted meanwhile, e.g. by another reader, the cached matrix is
+    // returned and the given one is left as is.
+    Matrix insert(int segment, RowMajorMatrixXf& matrix);
+
+    // statistics.
+    long getHits();
+    long getMisses();
+    long getEvictions();
+    void printStatistics();
+
+private:
+    long budgetBytes;
+    long usedBytes;
+
+    // All members are protected by mutex.
+    std::mutex mutex;
+
+    // the most recently used segment is at the front.
+    typedef std::list< std::pair<int, Matrix> > SegmentList;
+    SegmentList segments;
+    std::unordered_map<int, SegmentList::iterator> index;
+
+    long hits;
+    long misses;
+    long evictions;
+};
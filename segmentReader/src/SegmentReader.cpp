@@ -0,0 +1,317 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+#include <nanotimer.h>
+#include "SegmentReader.h"
+
+using namespace std;
+
+mutex SegmentReader::hdf5Mutex;
+
+SegmentReader::SegmentReader(h5pp::File& h5File_, const string& datasetName_,
+                             int segmentsNumber_, int prefetchDepth_):
+    h5File(h5File_), datasetName(datasetName_),
+    segmentsNumber(segmentsNumber_), prefetchDepth(prefetchDepth_)
+{
+    stopping  = false;
+    hits      = 0;
+    stalls    = 0;
+    stallTime = 0.0;
+
+    {
+        lock_guard<mutex> lock(hdf5Mutex);
+        file = h5File.openFileHandle();
+        flatLayout = h5File.linkExists("/segmentOffsets") &&
+                     h5File.linkExists("/" + datasetName);
+        if (flatLayout){
+            h5File.readDataset(segmentOffsets, "/segmentOffsets");
+            assert( int(segmentOffsets.size()) > segmentsNumber );
+            flatDataset = openDataset("/" + datasetName);
+        }
+    }
+
+    if (prefetchDepth > 0){
+        prefetchThread = thread(&SegmentReader::prefetch, this);
+    }
+}
+
+SegmentReader::~SegmentReader()
+{
+    if ( prefetchThread.joinable() ){
+        {
+            lock_guard<mutex> lock(slotsMutex);
+            stopping = true;
+        }
+        slotsChanged.notify_all();
+        prefetchThread.join();
+    }
+
+    lock_guard<mutex> lock(hdf5Mutex);
+    for (auto& openDataset: segmentDatasets){
+        H5Dclose(openDataset.second.dataset);
+    }
+    if (flatLayout){
+        H5Dclose(flatDataset.dataset);
+    }
+}
+
+bool SegmentReader::isFlatLayout()
+{
+    return flatLayout;
+}
+
+SegmentReader::DatasetHandle SegmentReader::openDataset(const string& path)
+{
+    DatasetHandle handle;
+    handle.dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+    if (handle.dataset < 0){
+        throw runtime_error( fmt::format("cannot open dataset {}", path) );
+    }
+
+    hid_t fileSpace = H5Dget_space(handle.dataset);
+    hsize_t dims[2];
+    H5Sget_simple_extent_dims(fileSpace, dims, nullptr);
+    H5Sclose(fileSpace);
+    handle.rows = dims[0];
+    handle.cols = dims[1];
+
+    return handle;
+}
+
+const SegmentReader::DatasetHandle& SegmentReader::getSegmentDataset(int segment)
+{
+    auto found = segmentDatasetsIndex.find(segment);
+    if (found != segmentDatasetsIndex.end()){
+        segmentDatasets.splice(segmentDatasets.begin(), segmentDatasets, found->second);
+        return found->second->second;
+    }
+
+    if (int(segmentDatasets.size()) >= maxOpenSegmentDatasets){
+        H5Dclose(segmentDatasets.back().second.dataset);
+        segmentDatasetsIndex.erase(segmentDatasets.back().first);
+        segmentDatasets.pop_back();
+    }
+
+    DatasetHandle handle = openDataset( fmt::format("segments/{}/{}", segment, datasetName) );
+    segmentDatasets.emplace_front(segment, handle);
+    segmentDatasetsIndex[segment] = segmentDatasets.begin();
+    return segmentDatasets.front().second;
+}
+
+void SegmentReader::readRowRanges(const DatasetHandle& handle,
+                                  const vector< pair<long, long> >& rowRanges,
+                                  RowMajorMatrixXf& matrix)
+{
+    hid_t fileSpace = H5Dget_space(handle.dataset);
+
+    // select the rows.
+    hsize_t rowsNumber = 0;
+    H5Sselect_none(fileSpace);
+    for (const auto& [startRow, endRow]: rowRanges){
+        assert( startRow <= endRow && hsize_t(endRow) <= handle.rows );
+        if (startRow == endRow) continue;
+        hsize_t offset[2] = { hsize_t(startRow), 0 };
+        hsize_t count[2]  = { hsize_t(endRow - startRow), handle.cols };
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_OR, offset, nullptr, count, nullptr);
+        rowsNumber += count[0];
+    }
+
+    matrix.resize(rowsNumber, handle.cols);
+    herr_t status = 0;
+    if (rowsNumber > 0){
+        hsize_t memoryDims[2] = { rowsNumber, handle.cols };
+        hid_t memorySpace = H5Screate_simple(2, memoryDims, nullptr);
+        status = H5Dread(handle.dataset, H5T_NATIVE_FLOAT, memorySpace, fileSpace,
+                         H5P_DEFAULT, matrix.data());
+        H5Sclose(memorySpace);
+    }
+
+    H5Sclose(fileSpace);
+    if (status < 0){
+        throw runtime_error( fmt::format("cannot read rows of dataset {}", datasetName) );
+    }
+}
+
+void SegmentReader::readSegment(int segment, RowMajorMatrixXf& matrix)
+{
+    lock_guard<mutex> lock(hdf5Mutex);
+    if (flatLayout){
+        readRowRanges(flatDataset,
+                      { {segmentOffsets[segment], segmentOffsets[segment + 1]} }, matrix);
+    }else{
+        const DatasetHandle& handle = getSegmentDataset(segment);
+        readRowRanges(handle, { {0, handle.rows} }, matrix);
+    }
+}
+
+void SegmentReader::readSegments(int firstSegment, vector<RowMajorMatrixXf>& matrixes)
+{
+    if ( !flatLayout ){
+        for (size_t i=0; i<matrixes.size(); i++){
+            readSegment(firstSegment + i, matrixes[i]);
+        }
+        return;
+    }
+
+    // the segments are consecutive in the file, so they are read at once and then split.
+    int endSegment = firstSegment + matrixes.size();
+    long firstRow  = segmentOffsets[firstSegment];
+    RowMajorMatrixXf rows;
+    {
+        lock_guard<mutex> lock(hdf5Mutex);
+        readRowRanges(flatDataset, { {firstRow, segmentOffsets[endSegment]} }, rows);
+    }
+    for (size_t i=0; i<matrixes.size(); i++){
+        long startRow = segmentOffsets[firstSegment + i] - firstRow;
+        long endRow   = segmentOffsets[firstSegment + i + 1] - firstRow;
+        matrixes[i] = rows.middleRows(startRow, endRow - startRow);
+    }
+}
+
+void SegmentReader::readRows(int segment, const vector<int>& rows, RowMajorMatrixXf& matrix)
+{
+    // HDF5 returns the selected rows in their order in the file, so the rows are sorted and
+    // deduplicated before being selected.
+    vector<int> sortedRows(rows);
+    sort(sortedRows.begin(), sortedRows.end());
+    sortedRows.erase( unique(sortedRows.begin(), sortedRows.end()), sortedRows.end() );
+
+    // Runs of adjacent rows are selected as single ranges, as HDF5 takes more time to
+    // combine more selections.
+    long rowOffset = flatLayout ? segmentOffsets[segment] : 0;
+    vector< pair<long, long> > rowRanges;
+    for (int row: sortedRows){
+        if ( !rowRanges.empty() && rowRanges.back().second == rowOffset + row ){
+            rowRanges.back().second++;
+        }else{
+            rowRanges.push_back( {rowOffset + row, rowOffset + row + 1} );
+        }
+    }
+
+    RowMajorMatrixXf selectedRows;
+    {
+        lock_guard<mutex> lock(hdf5Mutex);
+        const DatasetHandle& handle = flatLayout ? flatDataset : getSegmentDataset(segment);
+        readRowRanges(handle, rowRanges, selectedRows);
+    }
+
+    // arrange the rows in the requested order.
+    matrix.resize(rows.size(), selectedRows.cols());
+    for (size_t i=0; i<rows.size(); i++){
+        int position = lower_bound(sortedRows.begin(), sortedRows.end(), rows[i])
+                       - sortedRows.begin();
+        matrix.row(i) = selectedRows.row(position);
+    }
+}
+
+void SegmentReader::read(int segment, RowMajorMatrixXf& matrix)
+{
+    assert( segment < segmentsNumber );
+
+    if (prefetchDepth == 0){
+        readSegment(segment, matrix);
+        return;
+    }
+
+    unique_lock<mutex> lock(slotsMutex);
+
+    // The requested segment is not on the way, so the access is not sequential. Previously
+    // scheduled segments are discarded and the requested one is read first.
+    if ( slots.count(segment) == 0 ){
+        slots.clear();
+        slots[segment].state = Pending;
+        slotsChanged.notify_all();
+    }
+
+    if ( slots[segment].state == Ready ){
+        hits++;
+    }else{
+        nanotimer timer;
+        timer.start();
+        slotsChanged.wait(lock, [&]{ return slots[segment].state == Ready; });
+        stalls++;
+        stallTime += timer.get_elapsed_ms();
+    }
+    matrix.swap( slots[segment].matrix );
+    slots.erase(segment);
+
+    // keep only the segments following the current one, and schedule those not scheduled yet.
+    int endSegment = min(segment + 1 + prefetchDepth, segmentsNumber);
+    for (auto it = slots.begin(); it != slots.end(); ){
+        if (it->first <= segment || it->first >= endSegment){
+            it = slots.erase(it);
+        }else{
+            it++;
+        }
+    }
+    for (int s=segment+1; s<endSegment; s++){
+        if ( slots.count(s) == 0 ){
+            slots[s].state = Pending;
+        }
+    }
+    slotsChanged.notify_all();
+}
+
+void SegmentReader::prefetch()
+{
+    unique_lock<mutex> lock(slotsMutex);
+    while (true){
+        // find the first pending segment.
+        auto pending = slots.end();
+        slotsChanged.wait(lock, [&]{
+            if (stopping) return true;
+            for (pending = slots.begin(); pending != slots.end(); pending++){
+                if (pending->second.state == Pending) return true;
+            }
+            return false;
+        });
+        if (stopping) break;
+
+        // With the flat layout, the following pending segments are read together with it.
+        int firstSegment = pending->first;
+        int count = 0;
+        for (auto it = pending; it != slots.end(); it++){
+            if (it->first != firstSegment + count || it->second.state != Pending) break;
+            it->second.state = Reading;
+            count++;
+            if ( !flatLayout ) break;
+        }
+
+        // read without holding the lock, so that clients can take segments already read.
+        lock.unlock();
+        vector<RowMajorMatrixXf> matrixes(count);
+        readSegments(firstSegment, matrixes);
+        lock.lock();
+
+        // the segments may have been discarded while being read.
+        for (int i=0; i<count; i++){
+            auto slot = slots.find(firstSegment + i);
+            if (slot != slots.end() && slot->second.state == Reading){
+                slot->second.matrix.swap(matrixes[i]);
+                slot->second.state = Ready;
+            }
+        }
+        slotsChanged.notify_all();
+    }
+}
+
+long SegmentReader::getHits()
+{
+    lock_guard<mutex> lock(slotsMutex);
+    return hits;
+}
+
+long SegmentReader::getStalls()
+{
+    lock_guard<mutex> lock(slotsMutex);
+    return stalls;
+}
+
+void SegmentReader::printStatistics()
+{
+    lock_guard<mutex> lock(slotsMutex);
+    cout << "segment reader(" << datasetName << "): "
+         << "hits " << hits << ", stalls " << stalls << ", "
+         << "time spent on stalls " << stallTime << " ms\n";
+}
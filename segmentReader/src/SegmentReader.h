@@ -0,0 +1,127 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <h5pp/h5pp.h>
+#include "matrixConversion.h"
+
+using std::string;
+using std::vector;
+
+// Reads the segments of a HDF5 file. When a segment is requested, the following segments
+// are read on a background thread, so that reading them overlaps with processing the
+// current segment.
+//
+// Two layouts of a file are supported, and the layout is detected by the reader.
+//   per-segment layout: segment i is the matrix "segments/{i}/{datasetName}".
+//   flat layout: all segments are concatenated into the matrix "/{datasetName}", and rows of
+//      segment i are [segmentOffsets[i], segmentOffsets[i+1]), where segmentOffsets is
+//      the vector "/segmentOffsets".
+// With the flat layout, consecutive segments to be prefetched are read by a single read.
+//
+// The file is kept open by the reader. Datasets of segments are opened when first read, and
+// the handles and shapes of the most recently read ones are kept, so that reading such a
+// segment again involves no path resolution or metadata query. At most
+// maxOpenSegmentDatasets of them are kept open; when another one is opened, the least
+// recently used one is closed, so that open handles and their chunk caches are bounded.
+class SegmentReader{
+public:
+    // prefetchDepth is the number of segments following the requested one to be read in
+    // background. If it is 0, segments are read synchronously.
+    SegmentReader(h5pp::File& h5File, const string& datasetName,
+                  int segmentsNumber, int prefetchDepth);
+    ~SegmentReader();
+
+    void read(int segment, RowMajorMatrixXf& matrix);
+
+    // read some rows of a segment, in the given order. Only the rows are read from the file,
+    // by a hyperslab selection. This is synchronous and independent of prefetching.
+    void readRows(int segment, const vector<int>& rows, RowMajorMatrixXf& matrix);
+
+    bool isFlatLayout();
+
+    // statistics.
+    // number of requests served by a segment already read in background.
+    long getHits();
+    // number of requests which had to wait for the segment to be read.
+    long getStalls();
+    void printStatistics();
+
+    // The HDF5 library is not thread-safe. While a reader exists, a client accessing any
+    // HDF5 file should hold this mutex.
+    static std::mutex hdf5Mutex;
+
+private:
+    // an opened two-dimensional dataset.
+    struct DatasetHandle{
+        hid_t   dataset;
+        hsize_t rows;
+        hsize_t cols;
+    };
+
+    // open a dataset and query its shape.
+    DatasetHandle openDataset(const string& path);
+    // return the handle of a dataset of the per-segment layout, opening it if necessary. The
+    // handle is valid until the next call. Both functions should be called with hdf5Mutex
+    // held.
+    const DatasetHandle& getSegmentDataset(int segment);
+
+    // Read the given ranges [start, end) of rows of a dataset by a hyperslab selection. The
+    // ranges should be sorted and disjoint. Rows of all ranges are concatenated. It should
+    // be called with hdf5Mutex held.
+    void readRowRanges(const DatasetHandle& handle,
+                       const vector< std::pair<long, long> >& rowRanges,
+                       RowMajorMatrixXf& matrix);
+
+private:
+    enum SlotState { Pending, Reading, Ready };
+    struct Slot{
+        SlotState state;
+        RowMajorMatrixXf matrix;
+    };
+
+    void readSegment(int segment, RowMajorMatrixXf& matrix);
+    // read segments [firstSegment, firstSegment + matrixes.size()).
+    void readSegments(int firstSegment, vector<RowMajorMatrixXf>& matrixes);
+
+    // body of the background thread.
+    void prefetch();
+
+private:
+    h5pp::File& h5File;
+    string datasetName;
+    int segmentsNumber;
+    int prefetchDepth;
+
+    // The following handles are protected by hdf5Mutex.
+    h5pp::hid::h5f file;
+    bool flatLayout;
+    // only used by the per-segment layout. Open datasets of segments, keyed by segment id.
+    // The most recently used one is at the front.
+    static const int maxOpenSegmentDatasets = 32;
+    typedef std::list< std::pair<int, DatasetHandle> > DatasetHandleList;
+    DatasetHandleList segmentDatasets;
+    std::unordered_map<int, DatasetHandleList::iterator> segmentDatasetsIndex;
+    // only used by the flat layout.
+    DatasetHandle flatDataset;
+    // only used by the flat layout. Shape is (segmentsNumber + 1).
+    vector<long> segmentOffsets;
+
+    // segments being read or already read in background, keyed by segment id. All the
+    // members below are protected by slotsMutex.
+    std::map<int, Slot> slots;
+    std::mutex slotsMutex;
+    std::condition_variable slotsChanged;
+    bool stopping;
+
+    long hits;
+    long stalls;
+    double stallTime;  // in ms.
+
+    std::thread prefetchThread;
+};
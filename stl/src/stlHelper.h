@@ -1,5 +1,8 @@
 #pragma once
 #include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
 
 template<typename C>
 void printContainer(const C& container, const std::string& containerName,
@@ -21,3 +24,18 @@ void printContainer(const C& container,
 {
     printContainer(container, containerName, container.size() );
 }
+
+// call function(threadIndex) for each threadIndex in [0, threadsNumber), on its own thread,
+// and wait for all the calls to return. The calling thread makes the first call.
+template<typename Function>
+void runInThreads(int threadsNumber, Function function)
+{
+    std::vector<std::thread> threads;
+    for (int threadIndex=1; threadIndex<threadsNumber; threadIndex++){
+        threads.emplace_back(function, threadIndex);
+    }
+    function(0);
+    for (std::thread& thread: threads){
+        thread.join();
+    }
+}